@@ -25,15 +25,145 @@
 #include "DefinedPins.h"
 #include "tinyprintf.h"
 #include "PrintSupport.h"
+#include "Settings.h"
+#include "Trace.h"
+#include "StartDetector.h"
+#include "Clock.h"
+#include "Transmitter.h"
 
 #include <assert.h>
 
 #define ADC_MAX ((uint16_t) 0x0FFFU)
 
+// Time from starting a conversion to the end of the sampling phase:
+// 480 + 12 ADC clock cycles at 9 MHz
+#define ADC_SAMPLE_TIME_US ((uint16_t) 55U)
+
+// Samples near a transmit edge are replaced by the last one used, but
+// after this many in a row the next is used anyway.  Otherwise a guard
+// that's too wide for the bit period would blank every sample while
+// transmitting and freeze the reading (so the tool stopping would never
+// be seen).
+#define MAX_BLANKED_IN_A_ROW ((uint8_t) 3U)
+
+// 2^6 = 64 sample averaging
+#define SUM_SHIFT 6
+#define NUM_SAMPLES (1 << SUM_SHIFT)
+
 // This variable is used to perform basic filtering on the measured
 // data
 static uint16_t averaged_adc_reading = (ADC_MAX >> 1);
 
+// Looks for motor starts in the individual samples
+static StartDetectorParameters start_parameters;
+static StartDetector start_detector;
+static bool start_detected = false;
+
+static RunStatistics run_statistics;
+static uint32_t last_sample_time;
+
+// Set if the conversion in progress was started near a transmit edge
+static bool sample_blanked = false;
+
+static NoiseStatistics noise_statistics;
+
+#ifdef TICKLESS_IDLE
+// Timer that triggers the conversions while the main loop is asleep
+// (counting microseconds, with an update event every millisecond)
+#define ATIMER TIM3
+#define IDLE_SAMPLE_PERIOD_US ((uint32_t) 1000U)
+// Start conversions on the rising edge of TIM3 TRGO
+#define ADC_TRIGGER_TIM3_TRGO (0x8U << ADC_CR2_EXTSEL_Pos)
+#define ADC_TRIGGER_RISING (0x1U << ADC_CR2_EXTEN_Pos)
+// The interrupt only wakes the core, so it has the lowest priority
+#define ADC_IRQ_PRIORITY 15U
+
+static bool watching = false;
+static volatile uint32_t analogue_wakeup_count = 0U;
+#endif
+
+// Thresholds converted from milliamps, and what they were converted
+// from (so that the division is only done when something changes)
+static struct {
+	uint32_t gain;
+	uint32_t high_milliamps;
+	uint32_t low_milliamps;
+	uint16_t high;
+	uint16_t low;
+} converted_thresholds = {0U, 0U, 0U, 0U, 0U};
+
+// Calibration needs a reading at least this far from the zero offset
+// for the gain to be accurate enough
+#define MINIMUM_CALIBRATION_CURRENT ((uint16_t) 20U)
+
+// Magnitude of a single sample in the same units as GetAnalogueCurrent
+static uint16_t GetSampleCurrent(uint16_t sample)
+{
+	int32_t zeroed = (int32_t) sample - (int32_t) GetSetting(CurrentZeroOffsetSetting);
+	return (uint16_t) ((zeroed >= 0) ? zeroed : -zeroed);
+}
+
+// Rounded and limited to the ADC range
+static uint16_t ConvertFromMilliamps(uint32_t milliamps, uint32_t gain)
+{
+	uint64_t current = ((((uint64_t) milliamps) << 16) + (gain >> 1)) / gain;
+	return (uint16_t) ((current < ADC_MAX) ? current : ADC_MAX);
+}
+
+static void UpdateConvertedThresholds()
+{
+	uint32_t gain = GetSetting(CurrentGainSetting);
+	uint32_t high_milliamps = GetSetting(HysteresisHighMilliampsSetting);
+	uint32_t low_milliamps = GetSetting(HysteresisLowMilliampsSetting);
+
+	if ((gain != converted_thresholds.gain)
+			|| (high_milliamps != converted_thresholds.high_milliamps)
+			|| (low_milliamps != converted_thresholds.low_milliamps)) {
+		converted_thresholds.gain = gain;
+		converted_thresholds.high_milliamps = high_milliamps;
+		converted_thresholds.low_milliamps = low_milliamps;
+		converted_thresholds.high = ConvertFromMilliamps(high_milliamps, gain);
+		converted_thresholds.low = ConvertFromMilliamps(low_milliamps, gain);
+
+		// The settings keep high above low in mA, but with a coarse gain
+		// both can round (or be limited) to the same ADC value: keep the
+		// band at least one ADC unit wide so it's never inverted
+		if (converted_thresholds.high <= converted_thresholds.low) {
+			if (converted_thresholds.high > 0U) {
+				converted_thresholds.low = (uint16_t) (converted_thresholds.high - 1U);
+			}
+			else {
+				converted_thresholds.high = 1U;
+			}
+		}
+	}
+}
+
+uint16_t GetHighCurrentThreshold()
+{
+	if (GetSetting(MilliampThresholdsSetting) == 0U) {
+		return (uint16_t) GetSetting(CurrentHysteresisHighSetting);
+	}
+	UpdateConvertedThresholds();
+	return converted_thresholds.high;
+}
+
+uint16_t GetLowCurrentThreshold()
+{
+	if (GetSetting(MilliampThresholdsSetting) == 0U) {
+		return (uint16_t) GetSetting(CurrentHysteresisLowSetting);
+	}
+	UpdateConvertedThresholds();
+	return converted_thresholds.low;
+}
+
+static void UpdateStartParameters()
+{
+	start_parameters.level_threshold = GetHighCurrentThreshold();
+	start_parameters.slope_threshold = (uint16_t) GetSetting(StartSlopeSetting);
+	start_parameters.rearm_threshold = GetLowCurrentThreshold();
+}
+
 #if not defined(STM32F411xE)
 #error This analogue driver is for the F411xE
 #endif
@@ -61,11 +191,66 @@ void InitAnalogue()
 
 	// Configure the I/O pin as an analogue input
 	SetPinAsAnalogueIn(ANALOGUE_INPUT_PIN);
+
+#ifdef TICKLESS_IDLE
+	// The watchdog looks at channel 9 only; it's enabled (along with the
+	// trigger) while the main loop is asleep
+	ADC1->CR1 |= ADC_CR1_AWDSGL | (9U << ADC_CR1_AWDCH_Pos);
+	ADC1->CR2 |= ADC_TRIGGER_TIM3_TRGO;
+
+	// Timers on APB1 run at twice the bus clock if the bus is divided
+	uint32_t timer_clock_hz = GetAPB1ClockHz();
+	if (timer_clock_hz != (((uint32_t) GetClockSpeedMHz()) * 1000000U)) {
+		timer_clock_hz *= 2U;
+	}
+	ATIMER->CR1 = 0U;
+	ATIMER->CR2 = (uint32_t) 0U
+		| (0x2U << TIM_CR2_MMS_Pos); // TRGO on update
+	ATIMER->PSC = (uint16_t) ((timer_clock_hz / 1000000U) - 1U);
+	ATIMER->ARR = (uint16_t) (IDLE_SAMPLE_PERIOD_US - 1U);
+	ATIMER->EGR = TIM_EGR_UG; // Load the prescaler
+
+	NVIC_SetPriority(ADC_IRQn, ADC_IRQ_PRIORITY);
+	NVIC_EnableIRQ(ADC_IRQn);
+#endif
+
+	UpdateStartParameters();
+	start_detector.Init(&start_parameters);
+
+	last_sample_time = GetMillisecondCounter();
+	ResetRunStatistics();
+	ResetNoiseStatistics();
 }
 
-// 2^6 = 64 sample averaging
-#define SUM_SHIFT 6
-#define NUM_SAMPLES (1 << SUM_SHIFT)
+// Start a conversion, noting whether it will overlap an edge of the
+// transmitter output (the interrupts are disabled so that the timer
+// interrupt can't move the edge between the check and the start)
+static void StartConversion()
+{
+	uint16_t guard = (uint16_t) GetSetting(AdcGuardSetting);
+
+	__disable_irq();
+	sample_blanked = (guard > 0U) && IsNearTransmitEdge(ADC_SAMPLE_TIME_US, guard);
+	ADC1->CR2 |= ADC_CR2_SWSTART;
+	__enable_irq();
+}
+
+// Variance of a window of NUM_SAMPLES from the sum and sum of squares
+static void RecordNoise(uint32_t sum, uint32_t sum_of_squares)
+{
+	uint64_t spread = (((uint64_t) sum_of_squares) << SUM_SHIFT) - (((uint64_t) sum) * sum);
+	uint32_t variance = (uint32_t) ((spread * 100U) >> (2 * SUM_SHIFT));
+
+	noise_statistics.last_variance = variance;
+	if (IsTransmitting()) {
+		noise_statistics.transmit_windows++;
+		noise_statistics.transmit_variance_total += variance;
+	}
+	else {
+		noise_statistics.idle_windows++;
+		noise_statistics.idle_variance_total += variance;
+	}
+}
 
 void UpdateAnalogue()
 {
@@ -84,6 +269,14 @@ void UpdateAnalogue()
 
 	static bool started = false;
 
+	// Used in place of samples taken near transmit edges
+	static uint16_t last_clean_sample = (ADC_MAX >> 1);
+	static uint8_t blanked_in_a_row = 0U;
+
+	// For the noise figure of the current window
+	static uint32_t window_sum = 0U;
+	static uint32_t window_sum_of_squares = 0U;
+
 	uint32_t sum;
 
 	if ( ! started ) {
@@ -97,13 +290,45 @@ void UpdateAnalogue()
 
 	if ((ADC1->SR & ADC_SR_EOC) != 0) {
 		// Data ready (end of conversion) flag has been set, so get the latest value
-		sample_history[sample_index] = (uint16_t) ADC1->DR;
+		uint16_t sample = (uint16_t) ADC1->DR;
+		noise_statistics.samples++;
+		if (sample_blanked && (blanked_in_a_row < MAX_BLANKED_IN_A_ROW)) {
+			noise_statistics.blanked_samples++;
+			blanked_in_a_row++;
+			sample = last_clean_sample;
+		}
+		else {
+			blanked_in_a_row = 0U;
+			last_clean_sample = sample;
+		}
+		sample_history[sample_index] = sample;
+		window_sum += sample;
+		window_sum_of_squares += (uint32_t) sample * sample;
+
+		uint16_t sample_current = GetSampleCurrent(sample_history[sample_index]);
+		UpdateStartParameters();
+		if (start_detector.AddSample(sample_current)) {
+			start_detected = true;
+		}
+
+		// Samples are usually 1 ms apart, but further apart when idle
+		uint32_t now = GetMillisecondCounter();
+		uint32_t interval = now - last_sample_time;
+		last_sample_time = now;
+		if (GetAnalogueCurrent() > GetLowCurrentThreshold()) {
+			run_statistics.on_time_ms += interval;
+			run_statistics.charge += ((uint64_t) sample_current) * interval;
+		}
 
 		// Increment (with wrap) the index into the history buffer
 		sample_index += 1;
 		if (sample_index >= NUM_SAMPLES) {
 			filled_buffer = true;
 			sample_index = 0;
+
+			RecordNoise(window_sum, window_sum_of_squares);
+			window_sum = 0U;
+			window_sum_of_squares = 0U;
 		}
 
 		// As long as we've filled the buffer at least once, we can calculate
@@ -115,24 +340,146 @@ void UpdateAnalogue()
 			}
 
 			averaged_adc_reading = (uint16_t) (sum >> SUM_SHIFT);
+
+			if (sample_index == 0) {
+				// Completed another full window of samples
+				TRACE(TraceAdcWindow, averaged_adc_reading);
+			}
 		}
 
 		// Start the next conversion
-		ADC1->CR2 |= ADC_CR2_SWSTART;
+		StartConversion();
+	}
+}
+
+#ifdef TICKLESS_IDLE
+extern "C" void ADC_IRQHandler(void);
+extern "C" void ADC_IRQHandler(void)
+{
+	// A sample has gone beyond the watchdog thresholds: the interrupt is
+	// only here to wake the core, so it's turned off until the next time
+	// the main loop goes to sleep
+	ADC1->CR1 &= ~ADC_CR1_AWDIE;
+	ADC1->SR = (uint32_t) ~ADC_SR_AWD;
+	analogue_wakeup_count++;
+}
+
+// Called just before the main loop goes to sleep: sample every
+// millisecond without the core and wake it up if the current goes above
+// the high threshold (in either direction from the zero offset, as the
+// current is the magnitude of the difference)
+void StartAnalogueWatch()
+{
+	uint32_t zero = GetSetting(CurrentZeroOffsetSetting);
+	uint32_t threshold = GetHighCurrentThreshold();
+
+	ADC1->HTR = ((zero + threshold) < ADC_MAX) ? (zero + threshold) : ADC_MAX;
+	ADC1->LTR = (zero > threshold) ? (zero - threshold) : 0U;
+	ADC1->SR = (uint32_t) ~ADC_SR_AWD;
+	ADC1->CR1 |= ADC_CR1_AWDEN | ADC_CR1_AWDIE;
+	ADC1->CR2 |= ADC_TRIGGER_RISING;
+
+	ATIMER->CNT = 0U;
+	ATIMER->CR1 |= TIM_CR1_CEN;
+
+	// Nothing is transmitted while idle
+	sample_blanked = false;
+	watching = true;
+}
+
+// Called on waking up: back to one software-started conversion per main
+// loop.  The latest triggered conversion is left in the data register,
+// so the next update uses it.
+void EndAnalogueWatch()
+{
+	if ( ! watching) {
+		return;
+	}
+	// If a conversion has only just been triggered, let it finish so that
+	// the next software start isn't ignored
+	while (ATIMER->CNT < ADC_SAMPLE_TIME_US) {
+		// Wait (for at most ADC_SAMPLE_TIME_US)
 	}
+	ATIMER->CR1 &= ~TIM_CR1_CEN;
+	ADC1->CR2 &= ~ADC_CR2_EXTEN;
+	ADC1->CR1 &= ~(ADC_CR1_AWDEN | ADC_CR1_AWDIE);
+	ADC1->SR = (uint32_t) ~ADC_SR_AWD;
+	watching = false;
+}
+
+// Number of times the analogue watchdog has woken the core
+uint32_t GetAnalogueWakeupCount()
+{
+	return analogue_wakeup_count;
 }
+#endif
 
 // Current is returned as absolute value but in ADC units
 // 1 LSB is about 24 mA; however, the zero reference is
 // unlikely to be very accurate - tests showed at least
-// 300 mA recorded with no current flowing.
+// 300 mA recorded with no current flowing (hence the adjustable
+// zero offset).  See GetCurrentMilliamps for calibrated values.
 uint16_t GetAnalogueCurrent()
 {
-	int32_t zeroed = averaged_adc_reading - (ADC_MAX >> 1);
-	if (zeroed >= 0) {
-		return (uint16_t) zeroed;
-	}
-	else {
-		return (uint16_t) (-zeroed);
+	return GetSampleCurrent(averaged_adc_reading);
+}
+
+// Q16 gain, so just a multiply and a shift
+uint32_t ConvertToMilliamps(uint16_t current)
+{
+	return (uint32_t) ((((uint64_t) current) * GetSetting(CurrentGainSetting)) >> 16);
+}
+
+uint32_t GetCurrentMilliamps()
+{
+	return ConvertToMilliamps(GetAnalogueCurrent());
+}
+
+SettingResult CalibrateZero()
+{
+	return SetSetting(CurrentZeroOffsetSetting, averaged_adc_reading);
+}
+
+SettingResult CalibrateLoad(uint32_t milliamps)
+{
+	uint16_t current = GetAnalogueCurrent();
+	if (current < MINIMUM_CALIBRATION_CURRENT) {
+		return SettingOutOfRange;
 	}
+	return SetSetting(CurrentGainSetting,
+			(uint32_t) (((((uint64_t) milliamps) << 16) + (current >> 1)) / current));
+}
+
+const NoiseStatistics *GetNoiseStatistics()
+{
+	return &noise_statistics;
+}
+
+void ResetNoiseStatistics()
+{
+	noise_statistics.last_variance = 0U;
+	noise_statistics.idle_windows = 0U;
+	noise_statistics.idle_variance_total = 0U;
+	noise_statistics.transmit_windows = 0U;
+	noise_statistics.transmit_variance_total = 0U;
+	noise_statistics.samples = 0U;
+	noise_statistics.blanked_samples = 0U;
+}
+
+const RunStatistics *GetRunStatistics()
+{
+	return &run_statistics;
+}
+
+void ResetRunStatistics()
+{
+	run_statistics.on_time_ms = 0U;
+	run_statistics.charge = 0U;
+}
+
+bool HasDetectedStart()
+{
+	bool detected = start_detected;
+	start_detected = false;
+	return detected;
 }
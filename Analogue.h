@@ -22,8 +22,62 @@
 
 #include <stdint.h>
 
+#include "Settings.h"
+
+// Totals since the last ResetRunStatistics for the time that the
+// averaged current has been above the lower hysteresis threshold
+typedef struct {
+	uint32_t on_time_ms;
+	uint64_t charge;       // Sum of current x time (ADC units x ms)
+} RunStatistics;
+
+// Spread of the raw samples in each averaging window, kept separately
+// for windows that ended while transmitting (to see how well the
+// samples near transmit edges are being blanked)
+typedef struct {
+	uint32_t last_variance;      // Hundredths of an ADC unit squared
+	uint32_t idle_windows;
+	uint64_t idle_variance_total;
+	uint32_t transmit_windows;
+	uint64_t transmit_variance_total;
+	uint32_t samples;
+	uint32_t blanked_samples;
+} NoiseStatistics;
+
 void InitAnalogue();
 void UpdateAnalogue();
 uint16_t GetAnalogueCurrent();
+// Averaged current in milliamps using the calibrated gain
+uint32_t GetCurrentMilliamps();
+uint32_t ConvertToMilliamps(uint16_t current);
+
+// Hysteresis thresholds in the same units as GetAnalogueCurrent (either
+// set directly or converted from the milliamp settings)
+uint16_t GetHighCurrentThreshold();
+uint16_t GetLowCurrentThreshold();
+
+// Two-point calibration: take the zero offset from the present reading
+// (with no current flowing) and then the gain from the present reading
+// with a known load.  The settings still need to be saved.
+SettingResult CalibrateZero();
+SettingResult CalibrateLoad(uint32_t milliamps);
+// Returns true (once) if a motor start has been recognised from the raw
+// samples since the last call (see StartDetector.h)
+bool HasDetectedStart();
+
+#ifdef TICKLESS_IDLE
+// While the main loop sleeps, a timer keeps triggering a conversion
+// every millisecond and the ADC's analogue watchdog wakes the core as
+// soon as a sample is beyond the high threshold
+void StartAnalogueWatch();
+void EndAnalogueWatch();
+uint32_t GetAnalogueWakeupCount();
+#endif
+
+const NoiseStatistics *GetNoiseStatistics();
+void ResetNoiseStatistics();
+
+const RunStatistics *GetRunStatistics();
+void ResetRunStatistics();
 
 #endif
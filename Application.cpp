@@ -29,36 +29,55 @@
 #include "PrintSupport.h"
 #include "Switches.h"
 #include "Transmitter.h"
+#include "Settings.h"
+#include "Timers.h"
+#include "Gestures.h"
+#include "HysteresisController.h"
+#include "RunOnPolicy.h"
+#include "Trace.h"
 
 #include "Application.h"
 
-#define CURRENT_HYSTERESIS_HIGH ((uint16_t) 70)
-#define CURRENT_HYSTERESIS_LOW ((uint16_t) 50)
+// Thresholds and timings are run-time adjustable: see Settings.cpp for
+// the defaults.  They're copied into the controller parameters on each
+// update.
+static HysteresisParameters parameters;
+static HysteresisController controller;
 
 // If set, this will force transmission of the measured current.  This is
 // useful if you want to assemble the unit, then plug it into a power tool
 // and read how much current is being measured.
 //#define TRANSMIT_CURRENT
 
+// Set at the end of each update
+static bool application_idle = false;
+
+static void UpdateParameters()
+{
+	parameters.high_threshold = GetHighCurrentThreshold();
+	parameters.low_threshold = GetLowCurrentThreshold();
+	parameters.run_on_ms = GetRunOnDelay(GetRunStatistics());
+	parameters.turn_off_ms = GetSetting(TurnOffDurationSetting);
+	parameters.confirm_ms = GetSetting(StartConfirmSetting);
+}
+
 void InitApplication()
 {
 	InitAnalogue();
 	InitTransmitter();
+
+	UpdateParameters();
+	controller.Init(&parameters);
+
+	// Ignore momentary push buttons for a while (1 second by default)
+	// after start-up
+	StartTimer(StartupIgnoreTimer, GetSetting(StartupIgnoreSetting));
 }
 
 void UpdateApplication()
 {
-	static uint32_t state_timer;
-	static uint32_t button_timer;
-	static enum {
-		IdleState,
-		TurningOnState,
-		DelayState,
-		TurningOffState
-	} current_state = IdleState;
 	static bool current_control = true;
 	static bool transmit_current = false;
-	static uint32_t delayed_start_timer = 0;
 	static bool delayed_start_complete = false;
 
 #ifdef TRANSMIT_CURRENT
@@ -66,40 +85,49 @@ void UpdateApplication()
 	transmit_current = true;
 #endif
 
-	UpdateAnalogue();
 	UpdateTransmitter();
 
+	// Always read (and so clear) the start detection so that a stale one
+	// isn't acted on later
+	bool start_detected = HasDetectedStart() && (GetSetting(PredictiveStartSetting) != 0U);
+
+	application_idle = false;
+
 	if ( ! delayed_start_complete) {
-		if (MillisecondsHaveElapsed(delayed_start_timer, 1000U)) {
+		if (TimerHasExpired(StartupIgnoreTimer)) {
 			delayed_start_complete = true;
 		}
-		// Ignore momentary push buttons for 1 second after start-up
-		(void) HasReceivedMomentaryButton(PushButtonSwitch);
+		ClearGestures();
 	}
-	else {
-		// Pressing the push button briefly will cause the transmitter to switch
-		// state, regardless of current (unless we're in transmit_current mode)
-		if (( ! transmit_current) && (HasReceivedMomentaryButton(PushButtonSwitch))) {
-			NextTransmitterState();
-			if (IsTransmitting()) {
-				current_control = false;
-			}
-			else {
-				current_control = true;
+
+	GestureEvent gesture;
+	while (GetNextGesture(&gesture)) {
+		if (gesture.name != PushButtonSwitch) {
+			continue;
+		}
+		if (gesture.type == GestureClick) {
+			// Pressing the push button briefly will cause the transmitter
+			// to switch state, regardless of current (unless we're in
+			// transmit_current mode).  Each click of a double click counts.
+			if ( ! transmit_current) {
+				NextTransmitterState();
+				if (IsTransmitting()) {
+					current_control = false;
+				}
+				else {
+					current_control = true;
+				}
 			}
 		}
-	}
-
-	if (GetSwitchState(PushButtonSwitch) && MillisecondsHaveElapsed(button_timer, 2000)) {
-		// Button has been held down for 2 seconds; switch into 
-		// current transmit mode (for diagnostic purposes)
-		current_control = false;
-		transmit_current = true;
-	}
-	else if (! GetSwitchState(PushButtonSwitch)) {
-		button_timer = GetMillisecondCounter();
-	}
-	else {
+		else if (gesture.type == GestureLongPress) {
+			// Button has been held down for long enough; switch into
+			// current transmit mode (for diagnostic purposes)
+			current_control = false;
+			transmit_current = true;
+		}
+		else {
+			// Other gestures are not used yet
+		}
 	}
 
 	// If we're in transmit_current mode, just send the latest current and don't
@@ -112,69 +140,41 @@ void UpdateApplication()
 	// If we're in current_control mode (the default), run a state machine to
 	// monitor the current and control the socket accordingly.
 	if (current_control) {
-		switch(current_state) {
-			default:
-			case IdleState:
-				// Idle: wait here until the current crosses the upper
-				// hysteresis band
-				if (GetAnalogueCurrent() > CURRENT_HYSTERESIS_HIGH) {
-					// Current has gone high, so start transmitting the turn-on
-					// signal and go to the turning on state
-					StartTransmitting(true);
-					current_state = TurningOnState;
-				}
-				else {
-					// Should be unnecessary, but doesn't hurt
-					StopTransmitting();
-				}
-				break;
+		ControllerState previous_state = controller.GetState();
 
-			case TurningOnState:
-				// We're now transmitting "turn on".  Keep doing that
-				// until the current drops below the lower threshold
-				if (GetAnalogueCurrent() < CURRENT_HYSTERESIS_LOW) {
-					// Current has gone low, leave the vacuum cleaner
-					// running for a little while to catch the last
-					// bits of sawdust
-					current_state = DelayState;
-					state_timer = GetMillisecondCounter();
-				}
+		UpdateParameters();
+		switch (controller.Update(GetMillisecondCounter(), GetAnalogueCurrent(), start_detected)) {
+			case OutputTransmitOn:
+				StartTransmitting(true);
 				break;
-
-			case DelayState:
-				if (GetAnalogueCurrent() > CURRENT_HYSTERESIS_LOW) {
-					// Current didn't stay below lower threshold,
-					// so go back to turn-on state
-					current_state = TurningOnState;
-				}
-				else if (MillisecondsHaveElapsed(state_timer, 2000)) {
-					// Current has been low for two seconds now,
-					// so start sending the "turn off" command
-					current_state = TurningOffState;
-					StartTransmitting(false);
-					state_timer = GetMillisecondCounter();
-				}
-				else {
-					// Just wait
-				}
+			case OutputTransmitOff:
+				StartTransmitting(false);
 				break;
-
-			case TurningOffState:
-				if (GetAnalogueCurrent() > CURRENT_HYSTERESIS_HIGH) {
-					// Current has gone back high again, so
-					// go straight back to turning on
-					current_state = TurningOnState;
-				}
-				else if (MillisecondsHaveElapsed(state_timer, 2000)) {
-					// We've been transmitting "turn off" for two
-					// seconds now: if it hasn't worked by now it
-					// probably won't!
-					current_state = IdleState;
-					StopTransmitting();
-				}
-				else {
-				}
+			case OutputStop:
+				StopTransmitting();
+				break;
+			case OutputNone:
+			default:
 				break;
 		}
+
+		if (controller.GetState() != previous_state) {
+			TRACE(TraceApplicationState, controller.GetState());
+			if (previous_state == IdleState) {
+				// Start of a new run: the run-on delay depends on this
+				// run only
+				ResetRunStatistics();
+			}
+		}
+		if (controller.GetState() == IdleState) {
+			application_idle = delayed_start_complete
+				&& ( ! IsTransmitting())
+				&& ( ! GetSwitchState(PushButtonSwitch));
+		}
 	}
 }
+
+bool IsApplicationIdle()
+{
+	return application_idle;
+}
@@ -23,5 +23,7 @@
 
 void InitApplication();
 void UpdateApplication();
+// True if nothing is happening (the main loop can run less often)
+bool IsApplicationIdle();
 
 #endif
@@ -22,7 +22,14 @@
 
 void CircularBuffer::addEntry(DTYPE data) {
 	if (this->isFull()) {
-		return;
+		this->dropCount++;
+		if (this->policy == OverflowDropOldest) {
+			// Make room by throwing away the oldest entry
+			(void) this->getEntry();
+		}
+		else {
+			return;
+		}
 	}
 
 	this->buffer[this->writeIndex] = data;
@@ -32,6 +39,7 @@ void CircularBuffer::addEntry(DTYPE data) {
 	else {
 		this->writeIndex++;
 	}
+	this->updateHighWaterMark();
 }
 
 DTYPE CircularBuffer::getEntry(void) {
@@ -88,5 +96,79 @@ uint16_t CircularBuffer::getSpace(void) {
 void CircularBuffer::clear(void) {
 	this->readIndex = 0;
 	this->writeIndex = 0;
+	this->highWaterMark = 0;
+	this->dropCount = 0;
 }
 
+void CircularBuffer::getWriteSpans(DTYPE **first, uint16_t *firstLength,
+		DTYPE **second, uint16_t *secondLength) {
+	uint16_t space = this->getSpace();
+	uint16_t untilEnd = this->bufLen - this->writeIndex;
+
+	*first = &(this->buffer[this->writeIndex]);
+	*second = &(this->buffer[0]);
+	if (space <= untilEnd) {
+		*firstLength = space;
+		*secondLength = 0;
+	}
+	else {
+		*firstLength = untilEnd;
+		*secondLength = space - untilEnd;
+	}
+}
+
+void CircularBuffer::commitEntries(uint16_t count) {
+	// Caller must not commit more than getSpace()
+	uint32_t newIndex = (uint32_t) this->writeIndex + count;
+	if (newIndex >= this->bufLen) {
+		newIndex -= this->bufLen;
+	}
+	this->writeIndex = (uint16_t) newIndex;
+	this->updateHighWaterMark();
+}
+
+void CircularBuffer::setOverflowPolicy(OverflowPolicy policy) {
+	this->policy = policy;
+}
+
+OverflowPolicy CircularBuffer::getOverflowPolicy(void) {
+	return this->policy;
+}
+
+// Throw away the oldest entries (counted as dropped)
+void CircularBuffer::discardEntries(uint16_t count) {
+	uint16_t entries = this->getNumEntries();
+	if (count > entries) {
+		count = entries;
+	}
+	uint32_t newIndex = (uint32_t) this->readIndex + count;
+	if (newIndex >= this->bufLen) {
+		newIndex -= this->bufLen;
+	}
+	this->readIndex = (uint16_t) newIndex;
+	this->dropCount += count;
+}
+
+// Record data that was dropped without being offered to addEntry
+void CircularBuffer::recordDrops(uint16_t count) {
+	this->dropCount += count;
+}
+
+uint16_t CircularBuffer::getHighWaterMark(void) {
+	return this->highWaterMark;
+}
+
+uint32_t CircularBuffer::getDropCount(void) {
+	return this->dropCount;
+}
+
+uint16_t CircularBuffer::getCapacity(void) {
+	return this->bufLen-1;
+}
+
+void CircularBuffer::updateHighWaterMark(void) {
+	uint16_t entries = this->getNumEntries();
+	if (entries > this->highWaterMark) {
+		this->highWaterMark = entries;
+	}
+}
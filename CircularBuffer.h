@@ -31,6 +31,16 @@
 // was easier to just use a #defined data type
 #define DTYPE uint8_t
 
+// What to do when adding to a full buffer.  The buffer itself can only
+// drop data: OverflowBlock means that the owner of the buffer should wait
+// for space before adding (if it still doesn't fit, the new data is
+// dropped).
+typedef enum {
+	OverflowDropNewest,
+	OverflowDropOldest,
+	OverflowBlock
+} OverflowPolicy;
+
 class CircularBuffer
 {
 	public:
@@ -43,11 +53,32 @@ class CircularBuffer
 		uint16_t getSpace(void);
 		void clear(void);
 
+		// Direct access to the free space for bulk writes: fill in (up to)
+		// the two returned regions in order and then commit the number of
+		// entries written.
+		void getWriteSpans(DTYPE **first, uint16_t *firstLength,
+				DTYPE **second, uint16_t *secondLength);
+		void commitEntries(uint16_t count);
+
+		// Overflow handling and statistics (for sizing the buffer)
+		void setOverflowPolicy(OverflowPolicy policy);
+		OverflowPolicy getOverflowPolicy(void);
+		void discardEntries(uint16_t count);
+		void recordDrops(uint16_t count);
+		uint16_t getHighWaterMark(void);
+		uint32_t getDropCount(void);
+		uint16_t getCapacity(void);
+
 	private:
+		void updateHighWaterMark(void);
+
 		static const uint16_t bufLen = CIRCULARBUFFER_LENGTH;
 		DTYPE buffer[CIRCULARBUFFER_LENGTH];
 		uint16_t readIndex;
 		uint16_t writeIndex;
+		OverflowPolicy policy;
+		uint16_t highWaterMark;
+		uint32_t dropCount;
 };
 
 #endif
@@ -18,10 +18,12 @@
 
 // Clock configuration
 
+#include "Global.h"
 #include "Clock.h"
 #include "cmsis.h"
 #include "Pins.h"
 #include "DefinedPins.h"
+#include "Profiler.h"
 
 #define RCC_CR_Default       ((uint32_t) 0x00000081)
 #define RCC_CFGR_Default     ((uint32_t) 0x24003010)
@@ -35,16 +37,51 @@
 #endif
 
 static volatile uint32_t MillisecondCounter = 0U;
+// Upper half of the 64-bit millisecond count (incremented when
+// MillisecondCounter wraps, every 49.7 days)
+static volatile uint32_t MillisecondCounterHigh = 0U;
 static uint8_t ClockSpeedMHz = 0U;
 
-extern "C" void SysTick_Handler(void)
+// Number of milliseconds covered by the current SysTick period (more
+// than one during tickless idle) and the number of cycles of the first
+// of those milliseconds that had already gone when the period started
+static volatile uint32_t TickPeriodMs = 1U;
+static volatile uint32_t TickOffsetCycles = 0U;
+
+// Number of times the core has been woken to run the main loop
+static volatile uint32_t WakeupCount = 0U;
+
+// SysTick is clocked from the core clock
+#define CYCLES_PER_MS (((uint32_t) ClockSpeedMHz) * 1000U)
+// The SysTick reload value is 24 bits (233 ms at 72 MHz)
+#define MAX_TICK_PERIOD_MS ((uint32_t) 200U)
+
+// In RAM so that the count carries on while flash is being erased
+extern "C" RAMFUNC void SysTick_Handler(void)
 {
+	PROFILE_START(start_cycles);
+
 	// Read the control register (clears the interrupt flag)
 	uint32_t dummy = SysTick->CTRL;
 	(void) dummy; // Get rid of a compiler warning
 
-	// This interrupt runs every millisecond: used for duration timing etc
-	MillisecondCounter++;
+	// This interrupt runs every millisecond (except during tickless idle):
+	// used for duration timing etc
+	uint32_t previous = MillisecondCounter;
+	MillisecondCounter = previous + TickPeriodMs;
+	if (MillisecondCounter < previous) {
+		MillisecondCounterHigh++;
+	}
+	WakeupCount++;
+
+	if ((TickPeriodMs != 1U) || (TickOffsetCycles != 0U)) {
+		// End of a tickless idle period (or the realignment after one):
+		// back to one interrupt per millisecond
+		SysTick->LOAD = CYCLES_PER_MS - 1U;
+		SysTick->VAL = 0U;
+		TickPeriodMs = 1U;
+		TickOffsetCycles = 0U;
+	}
 
 	// For some reason that I don't currently understand, if this line is
 	// removed, the "millisecond interrupt" only runs every 2 ms instead of
@@ -52,10 +89,12 @@ extern "C" void SysTick_Handler(void)
 	// optimisation being prevented by the volatile write in the pin toggle
 	// function, or (less likely) just increasing the time before the SCR bit
 	// is set.
-	TogglePin(CLOCK_RANDOM_PIN);
+	ClockRandomPin::Toggle();
 
 	/* Do not return to wait mode after exiting this interrupt */
 	SCB->SCR &= (uint32_t) ~((uint32_t) SCB_SCR_SLEEPONEXIT_Msk);
+
+	PROFILE_END(SysTickProfile, start_cycles);
 }
 
 uint32_t GetMillisecondCounter(void)
@@ -64,39 +103,148 @@ uint32_t GetMillisecondCounter(void)
 	return local_copy;
 }
 
-bool MillisecondsHaveElapsed(uint32_t start_time, uint32_t duration)
+// Millisecond counter plus the number of core clock cycles since that
+// millisecond started (read consistently, in case the tick interrupt
+// happens between the two reads)
+void GetTickTime(uint32_t *milliseconds, uint32_t *cycles_into_tick)
 {
-	// Local copy of volatile
-	uint32_t current_time = MillisecondCounter;
-	uint32_t end_time = start_time + duration;
-	if ((end_time >= start_time) &&             // End time hasn't wrapped AND
-	        ((current_time >= end_time) ||      // system time has passed the end time OR
-	            (current_time < start_time)))   // system time has wrapped
-	{
-		return true;
+	uint32_t before;
+	uint32_t count;
+
+	do {
+		before = MillisecondCounter;
+		// SysTick counts down from LOAD to zero
+		count = (SysTick->LOAD - SysTick->VAL) + TickOffsetCycles;
+	} while (before != MillisecondCounter);
+
+	*milliseconds = before;
+	*cycles_into_tick = count;
+}
+
+// Microseconds since start-up.  Safe to call from any context: if the
+// SysTick interrupt can't run (because this is called from a higher
+// priority interrupt or with interrupts disabled), a pending tick is
+// allowed for so that time never goes backwards.
+uint64_t GetMicrosecondCounter(void)
+{
+	uint32_t low;
+	uint32_t high;
+	uint32_t count;
+	uint32_t period;
+	bool pending;
+
+	do {
+		low = MillisecondCounter;
+		high = MillisecondCounterHigh;
+		period = TickPeriodMs;
+		count = (SysTick->LOAD - SysTick->VAL) + TickOffsetCycles;
+		pending = ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0U);
+		if (pending) {
+			// The counter has reloaded but the tick hasn't been counted
+			// yet: read it again in case it reloaded after the first read
+			count = SysTick->LOAD - SysTick->VAL;
+		}
+	} while (low != MillisecondCounter);
+
+	if (ClockSpeedMHz == 0U) {
+		// SysTick not running yet (SetupClocks hasn't been called)
+		return 0U;
 	}
-	else if ((end_time <= start_time) &&        // End time has wrapped AND
-	        ((current_time >= end_time) &&      // system time has passed the end time AND
-	            (current_time < start_time)))   // system time has wrapped
-	{
-		return true;
+
+	uint64_t milliseconds = (((uint64_t) high) << 32) | low;
+	if (pending) {
+		milliseconds += period;
 	}
-	else {
-		return false;
+	return (milliseconds * 1000U) + (count / ClockSpeedMHz);
+}
+
+// Called after something that may have held off the SysTick interrupt
+// for more than a millisecond (only one tick can be pending, so the rest
+// are lost): count any whole milliseconds that the cycle counter says
+// have gone but the SysTick handler hasn't seen
+void CatchUpMillisecondCounter(uint32_t start_ms, uint32_t elapsed_cycles)
+{
+	if (ClockSpeedMHz == 0U) {
+		return;
 	}
+
+	__disable_irq();
+	uint32_t expected = elapsed_cycles / CYCLES_PER_MS;
+	uint32_t counted = MillisecondCounter - start_ms;
+	if (counted < expected) {
+		uint32_t previous = MillisecondCounter;
+		MillisecondCounter = previous + (expected - counted);
+		if (MillisecondCounter < previous) {
+			MillisecondCounterHigh++;
+		}
+	}
+	__enable_irq();
 }
 
-uint32_t ElapsedMilliseconds(uint32_t start_time)
+uint32_t GetWakeupCount(void)
 {
-	// Local copy of volatile
-	uint32_t current_time = MillisecondCounter;
-	if (current_time > start_time) {
-		return (current_time - start_time);
+	return WakeupCount;
+}
+
+#ifdef TICKLESS_IDLE
+// Stretch the current SysTick period so that the next interrupt is at
+// the end of the given number of milliseconds (counted from the start
+// of the current millisecond, so the tick stays in phase)
+void StartTicklessIdle(uint32_t milliseconds)
+{
+	if (milliseconds > MAX_TICK_PERIOD_MS) {
+		milliseconds = MAX_TICK_PERIOD_MS;
 	}
-	else {
-		return ((UINT32_MAX - start_time) + current_time + 1U);
+	if (milliseconds <= 1U) {
+		return;
+	}
+
+	__disable_irq();
+	uint32_t cycles_into_tick = (SysTick->LOAD - SysTick->VAL) + TickOffsetCycles;
+	// Don't bother if the tick is about to happen anyway
+	if (((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) == 0U)
+			&& (cycles_into_tick < (CYCLES_PER_MS - 100U))) {
+		SysTick->LOAD = (milliseconds * CYCLES_PER_MS) - cycles_into_tick - 1U;
+		SysTick->VAL = 0U;
+		TickOffsetCycles = cycles_into_tick;
+		TickPeriodMs = milliseconds;
+	}
+	__enable_irq();
+}
+
+// Called after waking up: if something other than SysTick woke the core,
+// count the whole milliseconds that have passed and realign SysTick to
+// the millisecond boundary
+void EndTicklessIdle(void)
+{
+	__disable_irq();
+	if ((TickPeriodMs != 1U) && ((SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) == 0U)) {
+		uint32_t elapsed = (SysTick->LOAD - SysTick->VAL) + TickOffsetCycles;
+		uint32_t whole_ms = elapsed / CYCLES_PER_MS;
+		uint32_t remainder = elapsed - (whole_ms * CYCLES_PER_MS);
+		uint32_t previous = MillisecondCounter;
+
+		MillisecondCounter = previous + whole_ms;
+		if (MillisecondCounter < previous) {
+			MillisecondCounterHigh++;
+		}
+		WakeupCount++;
+
+		// Run to the end of the current millisecond; the interrupt handler
+		// then goes back to the normal reload value
+		uint32_t reload = CYCLES_PER_MS - remainder - 1U;
+		if (reload < 100U) {
+			// Nearly there: keep the reload value sensible
+			reload = 100U;
+		}
+		SysTick->LOAD = reload;
+		SysTick->VAL = 0U;
+		TickOffsetCycles = remainder;
+		TickPeriodMs = 1U;
 	}
+	__enable_irq();
 }
+#endif
 
 void SetupClocks(void)
 {
@@ -186,6 +334,11 @@ void SetupClocks(void)
 
 	SysTick_Config(72000); // AHB ( = 72 MHz) / 72000 = 1 kHz
 	ClockSpeedMHz = 72;
+
+	// The cycle counter is used to catch up on lost ticks (see
+	// CatchUpMillisecondCounter)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
 }
 
 uint8_t GetClockSpeedMHz(void)
@@ -193,3 +346,28 @@ uint8_t GetClockSpeedMHz(void)
 	return ClockSpeedMHz;
 }
 
+// Convert an APB prescaler field (PPRE1 or PPRE2) into a shift:
+// 0xx is divide by 1, 100 is divide by 2, 101 by 4 etc
+static uint8_t APBPrescalerShift(uint32_t ppre)
+{
+	if (ppre < 0x4U) {
+		return 0U;
+	}
+	else {
+		return (uint8_t) (ppre - 0x3U);
+	}
+}
+
+// Peripheral clock frequencies, read back from the clock configuration
+// so that (e.g.) baud rate calculations always match the actual clocks
+uint32_t GetAPB1ClockHz(void)
+{
+	uint32_t ppre = (RCC->CFGR & RCC_CFGR_PPRE1_Msk) >> RCC_CFGR_PPRE1_Pos;
+	return (((uint32_t) ClockSpeedMHz) * 1000000U) >> APBPrescalerShift(ppre);
+}
+
+uint32_t GetAPB2ClockHz(void)
+{
+	uint32_t ppre = (RCC->CFGR & RCC_CFGR_PPRE2_Msk) >> RCC_CFGR_PPRE2_Pos;
+	return (((uint32_t) ClockSpeedMHz) * 1000000U) >> APBPrescalerShift(ppre);
+}
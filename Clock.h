@@ -23,10 +23,101 @@
 
 #include <stdint.h>
 
+// Time since start-up in microseconds.  This is 64 bits wide, so it
+// never wraps in practice and comparisons are plain subtractions.
+typedef struct {
+	uint64_t us;
+} Timestamp;
+
+// Point in time by which something should happen
+typedef struct {
+	uint64_t us;
+} Deadline;
+
+// Length of time in microseconds (signed so that the time until a
+// deadline that has passed is negative)
+typedef struct {
+	int64_t us;
+} Duration;
+
 void SetupClocks(void);
+uint64_t GetMicrosecondCounter(void);
 uint32_t GetMillisecondCounter(void);
-bool MillisecondsHaveElapsed(uint32_t start_time, uint32_t duration);
-uint32_t ElapsedMilliseconds(uint32_t start_time);
+uint32_t GetWakeupCount(void);
+void CatchUpMillisecondCounter(uint32_t start_ms, uint32_t elapsed_cycles);
+#ifdef TICKLESS_IDLE
+void StartTicklessIdle(uint32_t milliseconds);
+void EndTicklessIdle(void);
+#endif
 uint8_t GetClockSpeedMHz(void);
+void GetTickTime(uint32_t *milliseconds, uint32_t *cycles_into_tick);
+uint32_t GetAPB1ClockHz(void);
+uint32_t GetAPB2ClockHz(void);
+
+// The 32-bit millisecond functions use modular arithmetic, so they work
+// across the counter wrapping (as long as the times involved are less
+// than 49.7 days apart)
+static inline uint32_t ElapsedMilliseconds(uint32_t start_time)
+{
+	return (GetMillisecondCounter() - start_time);
+}
+
+static inline bool MillisecondsHaveElapsed(uint32_t start_time, uint32_t duration)
+{
+	return (ElapsedMilliseconds(start_time) >= duration);
+}
+
+static inline Duration Microseconds(int64_t us)
+{
+	Duration d = {us};
+	return d;
+}
+
+static inline Duration Milliseconds(int64_t ms)
+{
+	Duration d = {ms * 1000};
+	return d;
+}
+
+static inline uint32_t DurationInMilliseconds(Duration d)
+{
+	return (uint32_t) (d.us / 1000);
+}
+
+static inline Timestamp GetTimestamp(void)
+{
+	Timestamp t = {GetMicrosecondCounter()};
+	return t;
+}
+
+static inline Duration TimeSince(Timestamp start)
+{
+	Duration d = {(int64_t) (GetMicrosecondCounter() - start.us)};
+	return d;
+}
+
+static inline Deadline DeadlineAfter(Duration d)
+{
+	Deadline deadline = {GetMicrosecondCounter() + (uint64_t) d.us};
+	return deadline;
+}
+
+// Deadline relative to a timestamp (e.g. start-up, which is time zero)
+static inline Deadline DeadlineFrom(Timestamp start, Duration d)
+{
+	Deadline deadline = {start.us + (uint64_t) d.us};
+	return deadline;
+}
+
+static inline bool DeadlineHasPassed(Deadline deadline)
+{
+	return ((int64_t) (GetMicrosecondCounter() - deadline.us)) >= 0;
+}
+
+static inline Duration TimeUntil(Deadline deadline)
+{
+	Duration d = {(int64_t) (deadline.us - GetMicrosecondCounter())};
+	return d;
+}
 
 #endif
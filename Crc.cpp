@@ -0,0 +1,42 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// CRC-32 calculation (used to validate data stored in flash)
+
+#include "Crc.h"
+
+// Standard (reflected) CRC-32 polynomial
+#define CRC32_POLYNOMIAL ((uint32_t) 0xEDB88320U)
+
+// Add a 32-bit word (least significant byte first) to a running CRC.
+// This is a bitwise implementation: it's only used when loading and
+// saving settings, so a lookup table isn't worth the flash space.
+uint32_t UpdateCrc32(uint32_t crc, uint32_t word)
+{
+	crc ^= word;
+	for (int bit=0;bit<32;bit++) {
+		if ((crc & 0x1U) != 0) {
+			crc = (crc >> 1) ^ CRC32_POLYNOMIAL;
+		}
+		else {
+			crc >>= 1;
+		}
+	}
+	return crc;
+}
@@ -0,0 +1,31 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// CRC-32 calculation (used to validate data stored in flash)
+
+#ifndef CRC_H
+#define CRC_H
+
+#include <stdint.h>
+
+#define CRC32_INITIAL ((uint32_t) 0xFFFFFFFFU)
+
+uint32_t UpdateCrc32(uint32_t crc, uint32_t word);
+
+#endif
@@ -28,17 +28,50 @@
 #include "Switches.h"
 #include "_SocketInfo.h" // Auto-generated by python build script
 #include "Transmitter.h"
+#include "Settings.h"
+#include "Store.h"
+#include "Usage.h"
+#include "Timers.h"
+#include "Uart.h" // ISRBUFSIZE
+#include "Profiler.h"
+#include "LoopMonitor.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include "MemoryUsage.h"
+#include "RunOnPolicy.h"
 
 #include "tinyprintf.h"
 
 #include <string.h> // memset
+#include <stdlib.h> // strtoul
+#include <assert.h>
 #include <math.h>
 
-// How often (in milliseconds) should we print stuff to the UART?
-#define UI_INTERVAL_MS ((uint32_t) 100U)
+// How often (in milliseconds) the output byte rate is recalculated
+#define RATE_INTERVAL_MS ((uint32_t) 1000U)
 
-static void UpdateDebugScreen();
 static void IncomingCommandHandler();
+static void ContinueListing();
+static void ContinueSpeedTest();
+
+static bool full_refresh_required = true;
+
+// UART throughput test: sends lines of text through bufprintf as fast as
+// the outgoing buffer will accept them and reports the achieved rate
+#define SPEED_TEST_LINE "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz\r\n"
+#define SPEED_TEST_LINE_LENGTH ((uint16_t) (sizeof(SPEED_TEST_LINE) - 1))
+#define SPEED_TEST_MAX_KB ((uint32_t) 64U)
+static uint32_t speed_test_remaining = 0U;
+static bool speed_test_running = false;
+static Timestamp speed_test_start_time;
+static uint32_t speed_test_start_count;
+
+#ifdef TRACING
+// Trace dump in progress (as many records as will fit are sent per update)
+static bool trace_dump_running = false;
+static uint32_t trace_dump_index;
+static void ContinueTraceDump();
+#endif
 
 #ifdef PERIOD_DEBUGGING
 extern uint16_t period_us;
@@ -48,7 +81,7 @@ static void SetPeriod(uint16_t period) {period_us = period;}
 
 void InitDebug()
 {
-	// Nothing to do; function kept for consistency
+	StartPeriodicTimer(OutputRateTimer, RATE_INTERVAL_MS);
 }
 
 void UpdateDebug()
@@ -56,85 +89,899 @@ void UpdateDebug()
 	// Read incoming commands and do whatever is requested
 	IncomingCommandHandler();
 
-	// Only run this relatively infrequently so that
-	// we can spend a reasonable amount of time printing
-	// stuff
-	static uint32_t counter = 0;
-	static bool initialised = false;
-	if ( ! initialised) {
-		counter = GetMillisecondCounter();
-		initialised = true;
+	if (speed_test_running) {
+		ContinueSpeedTest();
 		return;
 	}
-	else if (! MillisecondsHaveElapsed(counter, UI_INTERVAL_MS)) {
+
+#ifdef TRACING
+	if (trace_dump_running) {
+		ContinueTraceDump();
 		return;
 	}
-	else {
-	}
-
-	// Restart counter
-	counter = GetMillisecondCounter();
+#endif
 
-	UpdateDebugScreen();
+	ContinueListing();
 }
 
 
-static void IncomingCommandHandler()
+// ANSI terminal control sequences used to draw the screen.  The screen
+// has a fixed layout: the header and labels are printed only on a full
+// refresh and after that only fields whose value has changed are
+// redrawn (in place, using cursor addressing).  Below the fields is a
+// command line and an area for command responses.
+#define ANSI_CLEAR_SCREEN "\x1b[2J"
+#define ANSI_CLEAR_TO_END_OF_SCREEN "\x1b[J"
+#define CURSOR_TO "\x1b[%u;%uH"
+
+// Row of the first field (below the build information header) and
+// column at which the values are printed
+#define FIRST_FIELD_ROW ((uint8_t) 9U)
+#define VALUE_COLUMN ((uint8_t) 21U)
+
+typedef enum _DebugFields
 {
-	char incoming = '\0';
+	MillisecondClockField,
+	AnalogueCurrentField,
+	PushButtonField,
+	TransmitStateField,
+	TransmitWordField,
+	CurrentMilliampsField,
+	AdcNoiseField,
+	RunOnDelayField,
+#ifdef PERIOD_DEBUGGING
+	PeriodField,
+#endif
+	OutputRateField,
+	BaudRateField,
+	TxPeakField,
+	TxDropField,
+	RxPeakField,
+	RxDropField,
+	RxOverrunField,
+	LoopOverrunField,
+	WorstOverrunField,
+	HeapPeakField,
+	StackPeakField,
+	WakeupRateField,
+	LastFieldIndex = WakeupRateField
+} DebugField;
 
-	if (bytes_waiting()) {
-		incoming = (char) get_incoming_byte();
-	}
+#define FIELD_COUNT (((int) LastFieldIndex)+1)
+
+#define PROMPT_ROW ((uint8_t) (FIRST_FIELD_ROW + FIELD_COUNT + 1))
+#define RESPONSE_ROW ((uint8_t) (PROMPT_ROW + 1))
+#define PROMPT "> "
+#define PROMPT_LENGTH 2
+
+// Maximum length of a command line; characters beyond this are ignored
+#define COMMAND_LINE_LENGTH 40
+// Limit on the number of received characters handled per update so that
+// the time spent in the command handler is bounded
+#define MAX_CHARACTERS_PER_UPDATE 8
+
+static char command_line[COMMAND_LINE_LENGTH+1];
+static uint8_t command_length = 0;
+
+// Index of the next setting to print if a "list" command is in progress
+// (one setting is printed per update), or -1 if not listing
+static int list_index = -1;
+
+#ifdef PROFILING
+// As above, for printing the profiler results (one point per update)
+static int profile_index = -1;
+#endif
 
-	switch (incoming) {
+typedef enum {
+	FormatHex32,
+	FormatHex16,
+	FormatHex8,
+	FormatBool,
+	FormatDecimal
+} FieldFormat;
+
+static uint32_t output_byte_rate = 0U;
+static uint32_t wakeup_rate = 0U;
+
+static uint32_t GetMillisecondClockValue() {return GetMillisecondCounter();}
+static uint32_t GetAnalogueCurrentValue() {return GetAnalogueCurrent();}
+static uint32_t GetPushButtonValue() {return GetPushButtonState() ? 1U : 0U;}
+static uint32_t GetTransmitStateValue() {return GetTransmitterState();}
+static uint32_t GetTransmitWordValue() {return GetTransmitWord();}
+static uint32_t GetCurrentMilliampsValue() {return GetCurrentMilliamps();}
+static uint32_t GetAdcNoiseValue() {return GetNoiseStatistics()->last_variance;}
+static uint32_t GetRunOnDelayValue() {return GetRunOnDelay(GetRunStatistics());}
 #ifdef PERIOD_DEBUGGING
-		case '+':
-			period_us += 1;
+static uint32_t GetPeriodValue() {return GetPeriod();}
+#endif
+static uint32_t GetOutputRateValue() {return output_byte_rate;}
+static uint32_t GetBaudRateValue() {return GetBaudRate();}
+static uint32_t GetWakeupRateValue() {return wakeup_rate;}
+static uint32_t GetTxPeakValue() {return GetStreamBuffer(OutgoingStream)->getHighWaterMark();}
+static uint32_t GetTxDropValue() {return GetStreamBuffer(OutgoingStream)->getDropCount();}
+static uint32_t GetRxPeakValue() {return GetStreamBuffer(IncomingStream)->getHighWaterMark();}
+static uint32_t GetRxDropValue() {return GetStreamBuffer(IncomingStream)->getDropCount();}
+// Number of receiver overruns (each loses at least one byte, but the
+// hardware doesn't say how many, so this isn't a byte count)
+static uint32_t GetRxOverrunValue() {return GetIsrRxOverrunCount();}
+static uint32_t GetLoopOverrunValue() {return GetLoopOverrunCount();}
+static uint32_t GetWorstOverrunValue() {return GetWorstLoopOverrun()->excess_us;}
+static uint32_t GetHeapPeakValue() {return GetHeapStatistics()->peak_bytes;}
+static uint32_t GetStackPeakValue() {return GetStackHighWaterMark();}
+
+// List of fields on the debug screen (one per row)
+static const struct {
+	DebugField name;
+	FieldFormat format;
+	uint32_t (*getter)();
+	const char *label;
+} FieldList[FIELD_COUNT] = {
+	{MillisecondClockField, FormatHex32,   GetMillisecondClockValue, "Millisecond Clock:"},
+	{AnalogueCurrentField,  FormatHex16,   GetAnalogueCurrentValue,  "Analogue Current:"},
+	{PushButtonField,       FormatBool,    GetPushButtonValue,       "Push Button State:"},
+	{TransmitStateField,    FormatHex8,    GetTransmitStateValue,    "Transmit State:"},
+	{TransmitWordField,     FormatHex32,   GetTransmitWordValue,     "Transmit Word:"},
+	{CurrentMilliampsField, FormatDecimal, GetCurrentMilliampsValue, "Current mA:"},
+	{AdcNoiseField,         FormatDecimal, GetAdcNoiseValue,         "ADC Variance x100:"},
+	{RunOnDelayField,       FormatDecimal, GetRunOnDelayValue,       "Run-on Delay ms:"},
+#ifdef PERIOD_DEBUGGING
+	{PeriodField,           FormatHex32,   GetPeriodValue,           "Period:"},
+#endif
+	{OutputRateField,       FormatDecimal, GetOutputRateValue,       "UART Bytes/s:"},
+	{BaudRateField,         FormatDecimal, GetBaudRateValue,         "UART Baud Rate:"},
+	{TxPeakField,           FormatDecimal, GetTxPeakValue,           "Tx Buffer Peak:"},
+	{TxDropField,           FormatDecimal, GetTxDropValue,           "Tx Bytes Dropped:"},
+	{RxPeakField,           FormatDecimal, GetRxPeakValue,           "Rx Buffer Peak:"},
+	{RxDropField,           FormatDecimal, GetRxDropValue,           "Rx Bytes Dropped:"},
+	{RxOverrunField,        FormatDecimal, GetRxOverrunValue,        "Rx Overruns:"},
+	{LoopOverrunField,      FormatDecimal, GetLoopOverrunValue,      "Loop Overruns:"},
+	{WorstOverrunField,     FormatDecimal, GetWorstOverrunValue,     "Worst Overrun us:"},
+	{HeapPeakField,         FormatDecimal, GetHeapPeakValue,         "Heap Peak Bytes:"},
+	{StackPeakField,        FormatDecimal, GetStackPeakValue,        "Stack Peak Bytes:"},
+	{WakeupRateField,       FormatDecimal, GetWakeupRateValue,       "Wakeups/s:"},
+};
+
+// Last value drawn for each field
+static uint32_t drawn_values[FIELD_COUNT];
+
+static void MoveCursor(uint8_t row, uint8_t column)
+{
+	bufprintf(CURSOR_TO, (unsigned int) row, (unsigned int) column);
+}
+
+static void DrawFieldValue(int i, uint32_t value)
+{
+	unsigned int row = FIRST_FIELD_ROW + i;
+	unsigned int column = VALUE_COLUMN;
+	int result;
+
+	// Each field is drawn with a single call so that it's either sent
+	// in full or not at all (if the outgoing buffer is full)
+	switch (FieldList[i].format) {
+		case FormatHex32:
+			result = bufprintf(CURSOR_TO "0x%08lX", row, column, value);
 			break;
-		case '-':
-			period_us -= 1;
+		case FormatHex16:
+			result = bufprintf(CURSOR_TO "0x%04lX", row, column, value);
 			break;
-		case ']':
-			period_us += 10;
+		case FormatHex8:
+			result = bufprintf(CURSOR_TO "0x%02lX", row, column, value);
 			break;
-		case '[':
-			period_us -= 10;
+		case FormatBool:
+			// Pad so that "True" fully overwrites "False"
+			result = bufprintf(CURSOR_TO "%s", row, column, (value != 0U) ? "True " : "False");
 			break;
-#endif
+		case FormatDecimal:
 		default:
+			// Clear to end of line as the width varies
+			result = bufprintf(CURSOR_TO "%lu\x1b[K", row, column, value);
 			break;
 	}
+
+	// If it wasn't sent, leave the old value so that it's tried again
+	if (result >= 0) {
+		drawn_values[i] = value;
+	}
 }
 
-static void UpdateDebugScreen()
+static void DrawFullScreen()
 {
-	printf("\f");
-	printf("Cordless Vacuum Starter\n");
+	bufprintf(ANSI_CLEAR_SCREEN);
+	MoveCursor(1, 1);
+	bufprintf("Cordless Vacuum Starter\n");
 #if defined(ST_NUCLEO_F411RE)
-	printf("Nucleo Version\n");
+	bufprintf("Nucleo Version\n");
 #elif defined(WEACT_BLACKPILL_F411CE)
-	printf("Black Pill Version\n");
+	bufprintf("Black Pill Version\n");
 #else
 	print("Unknown Version\n");
 #endif
-	printf("Changeset ID: " CHANGESET "\n");
-	printf("Build Date: " BUILD_DATE "\n");
-	printf("Version: " VERSION "\n");
-	printf(SOCKET_NAME "\n\n");
+	bufprintf("Changeset ID: " CHANGESET "\n");
+	bufprintf("Build Date: " BUILD_DATE "\n");
+	bufprintf("Version: " VERSION "\n");
+	bufprintf(SOCKET_NAME "\n\n");
+
+	for (int i=0;i<FIELD_COUNT;i++) {
+		MoveCursor(FIRST_FIELD_ROW + i, 1);
+		bufprintf("%s", FieldList[i].label);
+		DrawFieldValue(i, FieldList[i].getter());
+	}
+
+	MoveCursor(PROMPT_ROW, 1);
+	command_line[command_length] = '\0';
+	bufprintf(PROMPT "%s", command_line);
+}
+
+// Leave the cursor at the end of the command line so that the user can
+// see where they're typing
+static void ParkCursor()
+{
+	MoveCursor(PROMPT_ROW, PROMPT_LENGTH + command_length + 1);
+}
+
+static void UpdateOutputRate()
+{
+	static uint32_t last_byte_count = 0;
+	static uint32_t last_wakeup_count = 0;
+
+	if (TimerHasExpired(OutputRateTimer)) {
+		uint32_t byte_count = GetOutgoingByteCount();
+		uint32_t wakeup_count = GetWakeupCount();
+		// Unsigned subtraction handles counter wrap
+		output_byte_rate = byte_count - last_byte_count;
+		last_byte_count = byte_count;
+		wakeup_rate = wakeup_count - last_wakeup_count;
+		last_wakeup_count = wakeup_count;
+	}
+}
+
+bool IsDebugIdle()
+{
+#ifdef TRACING
+	if (trace_dump_running) {
+		return false;
+	}
+#endif
+#ifdef PROFILING
+	if (profile_index >= 0) {
+		return false;
+	}
+#endif
+	return (( ! speed_test_running) && (list_index < 0));
+}
+
+// Run by the scheduler every UI_INTERVAL_MS
+void UpdateDebugScreen()
+{
+	// The speed test and trace dump have the UART to themselves
+	if (speed_test_running) {
+		return;
+	}
+#ifdef TRACING
+	if (trace_dump_running) {
+		return;
+	}
+#endif
+
+	UpdateOutputRate();
+
+	if (full_refresh_required) {
+		DrawFullScreen();
+		full_refresh_required = false;
+		ParkCursor();
+		return;
+	}
+
+	bool drawn = false;
+	for (int i=0;i<FIELD_COUNT;i++) {
+		// Check that the fields are in the right order in the array
+		assert(FieldList[i].name == ((int) i));
+
+		uint32_t value = FieldList[i].getter();
+		if (value != drawn_values[i]) {
+			DrawFieldValue(i, value);
+			drawn = true;
+		}
+	}
+
+	if (drawn) {
+		ParkCursor();
+	}
+}
+
+// Print a setting's value and its valid range on the given row
+static void PrintSetting(uint8_t row, SettingName name)
+{
+	MoveCursor(row, 1);
+	if (GetSettingType(name) == SettingTypeBool) {
+		bufprintf("%-20s %s\x1b[K", GetSettingName(name),
+				(GetSetting(name) != 0U) ? "true" : "false");
+	}
+	else {
+		bufprintf("%-20s %lu (%lu-%lu)\x1b[K", GetSettingName(name), GetSetting(name),
+				GetSettingMinimum(name), GetSettingMaximum(name));
+	}
+}
+
+static bool ParseValue(const char *text, SettingType type, uint32_t *value)
+{
+	char *end;
+
+	if (type == SettingTypeBool) {
+		if ((strcmp(text, "true") == 0) || (strcmp(text, "1") == 0)) {
+			*value = 1U;
+			return true;
+		}
+		else if ((strcmp(text, "false") == 0) || (strcmp(text, "0") == 0)) {
+			*value = 0U;
+			return true;
+		}
+		return false;
+	}
+
+	if ((text[0] < '0') || (text[0] > '9')) {
+		return false;
+	}
+	// Base 0 accepts decimal or hexadecimal (with 0x prefix)
+	*value = (uint32_t) strtoul(text, &end, 0);
+	return (*end == '\0');
+}
+
+// Split the command line (in place) into at most max_words words
+// separated by spaces
+static int SplitCommandLine(char **words, int max_words)
+{
+	int count = 0;
+	char *ch = command_line;
+
+	while ((*ch != '\0') && (count < max_words)) {
+		while (*ch == ' ') {
+			*ch = '\0';
+			ch++;
+		}
+		if (*ch == '\0') {
+			break;
+		}
+		words[count] = ch;
+		count++;
+		while ((*ch != ' ') && (*ch != '\0')) {
+			ch++;
+		}
+	}
+	return count;
+}
+
+static const char *PolicyNames[] = {
+	"newest", // OverflowDropNewest
+	"oldest", // OverflowDropOldest
+	"block"   // OverflowBlock
+};
+
+static bool ParseOverflowPolicy(const char *text, OverflowPolicy *policy)
+{
+	for (int i=0;i<((int) (sizeof(PolicyNames)/sizeof(PolicyNames[0])));i++) {
+		if (strcmp(text, PolicyNames[i]) == 0) {
+			*policy = (OverflowPolicy) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+static bool ParseStreamName(const char *text, StreamName *stream)
+{
+	if (strcmp(text, "tx") == 0) {
+		*stream = OutgoingStream;
+		return true;
+	}
+	else if (strcmp(text, "rx") == 0) {
+		*stream = IncomingStream;
+		return true;
+	}
+	return false;
+}
+
+// Sizes, peak usage and losses for all of the UART buffers (to help
+// choose the buffer sizes)
+static void PrintBufferStatistics()
+{
+	CircularBuffer *tx = GetStreamBuffer(OutgoingStream);
+	CircularBuffer *rx = GetStreamBuffer(IncomingStream);
+
+	bufprintf("tx:     peak %u/%u dropped %lu (policy %s, %lu messages)\r\n",
+			tx->getHighWaterMark(), tx->getCapacity(), tx->getDropCount(),
+			PolicyNames[tx->getOverflowPolicy()], GetTruncatedMessageCount());
+	bufprintf("rx:     peak %u/%u dropped %lu (policy %s)\r\n",
+			rx->getHighWaterMark(), rx->getCapacity(), rx->getDropCount(),
+			PolicyNames[rx->getOverflowPolicy()]);
+	bufprintf("tx isr: peak %u/%u\r\n", GetIsrTxHighWaterMark(), ISRBUFSIZE - 1U);
+	bufprintf("rx isr: peak %u/%u overruns %lu",
+			GetIsrRxHighWaterMark(), ISRBUFSIZE - 1U, GetIsrRxOverrunCount());
+}
+
+// Main loop overrun details, including which task was running when
+// the millisecond tick fired
+static void PrintLoopOverruns()
+{
+	const LoopOverrun *worst = GetWorstLoopOverrun();
+	const LoopOverrun *last = GetLastLoopOverrun();
+
+	bufprintf("Overruns: %lu, missed ticks: %lu\r\n", GetLoopOverrunCount(), GetMissedTickCount());
+	if (GetLoopOverrunCount() == 0U) {
+		return;
+	}
+	bufprintf("Worst: %lu us in %s at 0x%08lX\r\n",
+			worst->excess_us, GetTaskName(worst->stage), worst->timestamp);
+	bufprintf("Last:  %lu us in %s at 0x%08lX",
+			last->excess_us, GetTaskName(last->stage), last->timestamp);
+}
+
+// Per-task run times against the budgets in the scheduler's table
+static void PrintTaskStatistics()
+{
+	uint32_t mhz = GetClockSpeedMHz();
+
+	for (int i=0;i<TASK_COUNT;i++) {
+		const TaskStatistics *stats = GetTaskStatistics((TaskName) i);
+		uint32_t average_us = 0U;
+		if (stats->runs > 0U) {
+			average_us = (uint32_t) (stats->total_cycles / stats->runs) / mhz;
+		}
+		bufprintf("%-18s %3lu ms: runs %lu avg %lu max %lu/%lu us over %lu deferred %lu%s",
+				GetTaskName((TaskName) i), GetTaskPeriod((TaskName) i),
+				stats->runs, average_us, stats->maximum_cycles / mhz,
+				GetTaskBudget((TaskName) i), stats->overruns, stats->deferrals,
+				(i < LastTaskIndex) ? "\r\n" : "");
+	}
+}
+
+// Space used in the persistent store and how often it's been written
+static void PrintStoreStatistics()
+{
+	const StoreStatistics *stats = GetStoreStatistics();
+
+	bufprintf("store: generation %lu records %u/%u pending %u\r\n",
+			stats->generation, stats->records_used, stats->records_total, stats->pending);
+	bufprintf("       writes %lu compactions %lu erases %lu errors %lu",
+			stats->writes, stats->compactions, stats->erases, stats->write_errors);
+}
+
+// Average variance of the ADC samples in each window (in hundredths)
+static void PrintVariance(const char *label, uint32_t windows, uint64_t total)
+{
+	uint32_t average = 0U;
+	if (windows > 0U) {
+		average = (uint32_t) (total / windows);
+	}
+	bufprintf("%-9s windows %lu variance %lu.%02lu",
+			label, windows, average / 100U, average % 100U);
+}
+
+// Noise on the raw ADC samples with and without the transmitter
+// running, and how many samples were blanked near transmit edges
+static void PrintNoiseStatistics()
+{
+	const NoiseStatistics *stats = GetNoiseStatistics();
+
+	bufprintf("samples %lu blanked %lu (guard %lu us)\r\n",
+			stats->samples, stats->blanked_samples, GetSetting(AdcGuardSetting));
+	PrintVariance("idle:", stats->idle_windows, stats->idle_variance_total);
+	bufprintf("\r\n");
+	PrintVariance("transmit:", stats->transmit_windows, stats->transmit_variance_total);
+#ifdef TICKLESS_IDLE
+	bufprintf("\r\nwoken by current: %lu", GetAnalogueWakeupCount());
+#endif
+}
+
+// Usage totals since the last "usage reset" (as saved in flash, apart
+// from anything since the last flush)
+static void PrintUsage()
+{
+	uint32_t cycles = GetUsage(VacuumCyclesUsage);
+	uint32_t average_cycle_s = 0U;
+	if (cycles > 0U) {
+		average_cycle_s = GetUsage(VacuumOnSecondsUsage) / cycles;
+	}
+
+	for (int i=0;i<USAGE_COUNT;i++) {
+		bufprintf("%-18s %lu\r\n", GetUsageName((UsageCounter) i), GetUsage((UsageCounter) i));
+	}
+	bufprintf("%-18s %lu\r\n", "average_cycle_s", average_cycle_s);
+	bufprintf("%-18s %lu\r\n", "average_current", GetAverageToolCurrent());
+	bufprintf("%-18s %lu\r\n", "peak_ma", ConvertToMilliamps((uint16_t) GetUsage(PeakCurrentUsage)));
+	bufprintf("%-18s %lu", "average_ma", ConvertToMilliamps((uint16_t) GetAverageToolCurrent()));
+}
+
+// Heap and stack usage (to help size the RAM reservations and check
+// that nothing is allocated once the main loop is running)
+static void PrintMemoryUsage()
+{
+#ifdef NO_HEAP
+	bufprintf("heap:  none (static build)\r\n");
+#else
+	const HeapStatistics *heap = GetHeapStatistics();
+
+	bufprintf("heap:  current %lu peak %lu largest %lu arena %lu\r\n",
+			heap->current_bytes, heap->peak_bytes, heap->largest_block, GetHeapArenaSize());
+	bufprintf("       allocs %lu frees %lu failed %lu after init %lu\r\n",
+			heap->allocation_count, heap->free_count, heap->failure_count, heap->post_init_count);
+#endif
+	bufprintf("stack: peak %lu/%lu%s",
+			GetStackHighWaterMark(), GetStackSize(),
+			StackOverflowDetected() ? " OVERFLOWED" : "");
+}
+
+static void ExecuteCommandLine()
+{
+	char *words[4];
+	int word_count;
+	SettingName name;
+	uint32_t value;
+
+	command_line[command_length] = '\0';
+	word_count = SplitCommandLine(words, 4);
+
+	MoveCursor(RESPONSE_ROW, 1);
+	bufprintf(ANSI_CLEAR_TO_END_OF_SCREEN);
+	list_index = -1;
+#ifdef PROFILING
+	profile_index = -1;
+#endif
 
-	printf("Millisecond Clock: 0x%08lX\n", GetMillisecondCounter());
-	printf("Analogue Current: 0x%04X\n", GetAnalogueCurrent());
-	printf("Push Button State: ");
-	if (GetPushButtonState()) {
-		printf("True\n");
+	if (word_count == 0) {
+		return;
+	}
+
+	if ((strcmp(words[0], "get") == 0) && (word_count == 2)) {
+		if (FindSetting(words[1], &name)) {
+			PrintSetting(RESPONSE_ROW, name);
+		}
+		else {
+			bufprintf("Unknown setting: %s", words[1]);
+		}
+	}
+	else if ((strcmp(words[0], "set") == 0) && (word_count == 3)) {
+		if ( ! FindSetting(words[1], &name)) {
+			bufprintf("Unknown setting: %s", words[1]);
+		}
+		else if ( ! ParseValue(words[2], GetSettingType(name), &value)) {
+			bufprintf("Invalid value: %s", words[2]);
+		}
+		else if (SetSetting(name, value) != SettingOK) {
+			bufprintf("Out of range: %s", words[2]);
+		}
+		else {
+			PrintSetting(RESPONSE_ROW, name);
+		}
+	}
+	else if ((strcmp(words[0], "list") == 0) && (word_count == 1)) {
+		list_index = 0;
+	}
+	else if ((strcmp(words[0], "save") == 0) && (word_count == 1)) {
+		if (SaveSettings() == SettingOK) {
+			bufprintf("Settings saved (%u writes pending)", GetStoreStatistics()->pending);
+		}
+		else {
+			bufprintf("Failed to save settings");
+		}
+	}
+	else if ((strcmp(words[0], "refresh") == 0) && (word_count == 1)) {
+		full_refresh_required = true;
+	}
+	else if ((strcmp(words[0], "baud") == 0) && (word_count == 1)) {
+		bufprintf("Baud rate: %lu", GetBaudRate());
+	}
+	else if ((strcmp(words[0], "baud") == 0) && (word_count == 2) && (strcmp(words[1], "ok") == 0)) {
+		// Received at the new rate, so the other end has switched too
+		ConfirmBaudRate();
+		bufprintf("Baud rate: %lu", GetBaudRate());
+	}
+	else if ((strcmp(words[0], "baud") == 0) && (word_count == 2)) {
+		if (ParseValue(words[1], SettingTypeUInt32, &value) && RequestBaudRate(value)) {
+			bufprintf("Switching to %lu baud: send \"baud ok\" within 3 s to keep it", value);
+		}
+		else {
+			bufprintf("Unsupported baud rate: %s", words[1]);
+		}
+	}
+	else if ((strcmp(words[0], "buffers") == 0) && (word_count == 1)) {
+		PrintBufferStatistics();
+	}
+	else if ((strcmp(words[0], "policy") == 0) && (word_count == 3)) {
+		StreamName stream;
+		OverflowPolicy policy;
+		if ( ! ParseStreamName(words[1], &stream)) {
+			bufprintf("Unknown stream: %s", words[1]);
+		}
+		else if ( ! ParseOverflowPolicy(words[2], &policy)) {
+			bufprintf("Unknown policy: %s", words[2]);
+		}
+		else {
+			GetStreamBuffer(stream)->setOverflowPolicy(policy);
+			PrintBufferStatistics();
+		}
+	}
+	else if ((strcmp(words[0], "calibrate") == 0) && (word_count == 2) && (strcmp(words[1], "zero") == 0)) {
+		if (CalibrateZero() == SettingOK) {
+			PrintSetting(RESPONSE_ROW, CurrentZeroOffsetSetting);
+		}
+		else {
+			bufprintf("Calibration failed");
+		}
+	}
+	else if ((strcmp(words[0], "calibrate") == 0) && (word_count == 3) && (strcmp(words[1], "load") == 0)) {
+		if ( ! ParseValue(words[2], SettingTypeUInt32, &value)) {
+			bufprintf("Invalid value: %s", words[2]);
+		}
+		else if (CalibrateLoad(value) != SettingOK) {
+			bufprintf("Calibration failed: check the load is on and the zero is calibrated");
+		}
+		else {
+			PrintSetting(RESPONSE_ROW, CurrentGainSetting);
+		}
+	}
+	else if ((strcmp(words[0], "noise") == 0) && (word_count == 1)) {
+		PrintNoiseStatistics();
+	}
+	else if ((strcmp(words[0], "noise") == 0) && (word_count == 2) && (strcmp(words[1], "reset") == 0)) {
+		ResetNoiseStatistics();
+		bufprintf("Noise statistics cleared");
+	}
+	else if ((strcmp(words[0], "usage") == 0) && (word_count == 1)) {
+		PrintUsage();
+	}
+	else if ((strcmp(words[0], "usage") == 0) && (word_count == 2) && (strcmp(words[1], "reset") == 0)) {
+		ResetUsage();
+		bufprintf("Usage cleared");
+	}
+	else if ((strcmp(words[0], "store") == 0) && (word_count == 1)) {
+		PrintStoreStatistics();
+	}
+	else if ((strcmp(words[0], "tasks") == 0) && (word_count == 1)) {
+		PrintTaskStatistics();
+	}
+	else if ((strcmp(words[0], "tasks") == 0) && (word_count == 2) && (strcmp(words[1], "reset") == 0)) {
+		ResetTaskStatistics();
+		bufprintf("Task statistics reset");
+	}
+	else if ((strcmp(words[0], "memory") == 0) && (word_count == 1)) {
+		PrintMemoryUsage();
+	}
+	else if ((strcmp(words[0], "loop") == 0) && (word_count == 1)) {
+		PrintLoopOverruns();
+	}
+	else if ((strcmp(words[0], "loop") == 0) && (word_count == 2) && (strcmp(words[1], "reset") == 0)) {
+		ResetLoopMonitor();
+		bufprintf("Loop monitor reset");
+	}
+#ifdef TRACING
+	else if ((strcmp(words[0], "trace") == 0) && (word_count == 1)) {
+		// Freeze the buffer and dump it in text form (for trace2json.py)
+		EnableTrace(false);
+		trace_dump_index = 0U;
+		trace_dump_running = true;
+		bufprintf("\r\nTRACE BEGIN %u %lu\r\n", (unsigned int) GetClockSpeedMHz(), GetTraceRecordCount());
+	}
+	else if ((strcmp(words[0], "trace") == 0) && (word_count == 2) && (strcmp(words[1], "clear") == 0)) {
+		ClearTrace();
+		bufprintf("Trace cleared");
+	}
+#endif
+#ifdef PROFILING
+	else if ((strcmp(words[0], "profile") == 0) && (word_count == 1)) {
+		profile_index = 0;
+	}
+	else if ((strcmp(words[0], "profile") == 0) && (word_count == 2) && (strcmp(words[1], "reset") == 0)) {
+		ResetProfiler();
+		bufprintf("Profiler reset");
+	}
+#endif
+	else if ((strcmp(words[0], "speedtest") == 0) && (word_count <= 2)) {
+		value = 16U;
+		if ((word_count == 2) && (( ! ParseValue(words[1], SettingTypeUInt32, &value))
+					|| (value == 0U) || (value > SPEED_TEST_MAX_KB))) {
+			bufprintf("Size must be 1-%lu kB", SPEED_TEST_MAX_KB);
+		}
+		else {
+			speed_test_remaining = value << 10;
+			speed_test_running = true;
+			speed_test_start_time = GetTimestamp();
+			speed_test_start_count = GetOutgoingByteCount();
+			bufprintf("\r\n");
+		}
 	}
 	else {
-		printf("False\n");
+		bufprintf("Commands: get <name>, set <name> <value>, list, save, refresh,"
+				" baud [<rate>|ok], speedtest [<kB>], buffers,"
+				" policy <tx|rx> <block|oldest|newest>, loop [reset], tasks [reset],"
+				" calibrate <zero|load <mA>>, noise [reset], usage [reset], store, memory"
+#ifdef PROFILING
+				", profile [reset]"
+#endif
+#ifdef TRACING
+				", trace [clear]"
+#endif
+				);
+	}
+}
+
+#ifdef TRACING
+static void ContinueTraceDump()
+{
+	uint32_t count = GetTraceRecordCount();
+
+	while (trace_dump_index < count) {
+		const TraceRecord *record = GetTraceRecord(trace_dump_index);
+		if (bufprintf("%08lX %08lX\r\n", record->timestamp, record->event) < 0) {
+			// Outgoing buffer full: carry on next time
+			return;
+		}
+		trace_dump_index++;
+	}
+
+	if (bufprintf("TRACE END\r\n") >= 0) {
+		trace_dump_running = false;
+		ClearTrace();
+		EnableTrace(true);
+		full_refresh_required = true;
 	}
-	printf("Transmit State: 0x%02X\n", GetTransmitterState());
-	printf("Transmit Word: 0x%08lX\n", GetTransmitWord());
+}
+#endif
+
+static void ContinueSpeedTest()
+{
+	// Queue as much as will fit (through PrintSupport, like the screen)
+	while ((speed_test_remaining > 0U) && (get_outgoing_space() >= SPEED_TEST_LINE_LENGTH)) {
+		bufprintf(SPEED_TEST_LINE);
+		if (speed_test_remaining > SPEED_TEST_LINE_LENGTH) {
+			speed_test_remaining -= SPEED_TEST_LINE_LENGTH;
+		}
+		else {
+			speed_test_remaining = 0U;
+		}
+	}
+
+	if ((speed_test_remaining == 0U) && outgoing_complete()) {
+		uint32_t elapsed = DurationInMilliseconds(TimeSince(speed_test_start_time));
+		uint32_t bytes = GetOutgoingByteCount() - speed_test_start_count;
+		if (elapsed == 0U) {
+			elapsed = 1U;
+		}
+
+		speed_test_running = false;
+		DrawFullScreen();
+		MoveCursor(RESPONSE_ROW, 1);
+		bufprintf("Sent %lu bytes in %lu ms at %lu baud: %lu bytes/s",
+				bytes, elapsed, GetBaudRate(), (bytes * 1000U) / elapsed);
+		ParkCursor();
+	}
+}
+
+#ifdef PROFILING
+// Print the cycle counts for one profile point: a summary line and a line
+// with the non-empty histogram buckets
+static void PrintProfile(uint8_t row, ProfilePoint point)
+{
+	const ProfileStatistics *stats = GetProfileStatistics(point);
+	uint32_t mean = 0U;
+
+	if (stats->count > 0U) {
+		mean = (uint32_t) (stats->total / stats->count);
+	}
+
+	MoveCursor(row, 1);
+	if (stats->count == 0U) {
+		bufprintf("%-18s no samples\x1b[K", GetProfileName(point));
+		return;
+	}
+	bufprintf("%-18s n=%lu min=%lu max=%lu mean=%lu cycles\x1b[K",
+			GetProfileName(point), stats->count, stats->minimum, stats->maximum, mean);
+
+	MoveCursor(row + 1, 3);
+	for (int b=0;b<PROFILE_BUCKET_COUNT;b++) {
+		if (stats->histogram[b] != 0U) {
+			bufprintf(" 2^%d:%lu", b, stats->histogram[b]);
+		}
+	}
+	bufprintf("\x1b[K");
+}
+#endif
+
+static void ContinueListing()
+{
+#ifdef PROFILING
+	if (profile_index >= 0) {
+		PrintProfile(RESPONSE_ROW + (profile_index * 2), (ProfilePoint) profile_index);
+		profile_index++;
+		if (profile_index >= PROFILE_POINT_COUNT) {
+			profile_index = -1;
+		}
+		ParkCursor();
+		return;
+	}
+#endif
+
+	if (list_index < 0) {
+		return;
+	}
+
+	PrintSetting(RESPONSE_ROW + list_index, (SettingName) list_index);
+	list_index++;
+	if (list_index >= SETTING_COUNT) {
+		list_index = -1;
+	}
+	ParkCursor();
+}
+
+static void IncomingCommandHandler()
+{
+	char incoming;
+
+	for (int i=0;(i<MAX_CHARACTERS_PER_UPDATE) && bytes_waiting();i++) {
+		incoming = (char) get_incoming_byte();
+
 #ifdef PERIOD_DEBUGGING
-	printf("Period: 0x%08lX\n", GetPeriod());
+		// Single character commands (only at the start of a line)
+		if (command_length == 0) {
+			bool handled = true;
+			switch (incoming) {
+				case '+':
+					period_us += 1;
+					break;
+				case '-':
+					period_us -= 1;
+					break;
+				case ']':
+					period_us += 10;
+					break;
+				case '[':
+					period_us -= 10;
+					break;
+				default:
+					handled = false;
+					break;
+			}
+			if (handled) {
+				continue;
+			}
+		}
 #endif
+
+		switch (incoming) {
+			case '\f': // Ctrl-L
+				// Redraw the whole screen (e.g. after the terminal has been
+				// reconnected or cleared)
+				full_refresh_required = true;
+				break;
+
+			case '\r':
+			case '\n':
+				ExecuteCommandLine();
+				// Start a new line
+				command_length = 0;
+				MoveCursor(PROMPT_ROW, PROMPT_LENGTH + 1);
+				bufprintf("\x1b[K");
+				// Only one command per update
+				return;
+
+			case '\b':
+			case 0x7F: // Delete
+				if (command_length > 0) {
+					command_length--;
+					ParkCursor();
+					bufprintf(" ");
+					ParkCursor();
+				}
+				break;
+
+			default:
+				if ((incoming >= ' ') && (incoming <= '~') && (command_length < COMMAND_LINE_LENGTH)) {
+					ParkCursor();
+					command_line[command_length] = incoming;
+					command_length++;
+					printchar(incoming);
+				}
+				break;
+		}
+	}
 }
@@ -21,7 +21,18 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include <stdint.h>
+
+// How often (in milliseconds) should we print stuff to the UART?
+#define UI_INTERVAL_MS ((uint32_t) 100U)
+
 void InitDebug();
+// Handles commands and multi-tick output (run every tick)
 void UpdateDebug();
+// Redraws the changed fields (only run every UI_INTERVAL_MS so that we
+// can spend a reasonable amount of time printing stuff)
+void UpdateDebugScreen();
+// True if no multi-tick output (listing, speed test etc) is in progress
+bool IsDebugIdle();
 
 #endif
@@ -22,39 +22,58 @@
 #ifndef DEFINEDPINS_H
 #define DEFINEDPINS_H
 
+// Each pin is defined as a Pin type (see Pins.h) for fast atomic access
+// and as a "port, pin" macro pair for the configuration functions.
+
+#include "Pins.h"
+
+#define PIN_ARGS(type) type::Port(), type::PinNumber
+
 // PORT A
 
 // Push button switch (pulls down on press)
 #if defined(WEACT_BLACKPILL_F411CE)
-#define PUSH_BUTTON_PIN         GPIOA, 0U
+typedef Pin<GPIOA_BASE, 0U> PushButtonPin;
 #elif defined(ST_NUCLEO_F411RE)
-#define PUSH_BUTTON_PIN         GPIOC, 13
+typedef Pin<GPIOC_BASE, 13U> PushButtonPin;
 #endif
+#define PUSH_BUTTON_PIN         PIN_ARGS(PushButtonPin)
 
 // Transmit output (T2CH2)
-#define TRANSMIT_PIN            GPIOA, 1U
+typedef Pin<GPIOA_BASE, 1U> TransmitPin;
+#define TRANSMIT_PIN            PIN_ARGS(TransmitPin)
 // USB UART TX
-#define UART_TX_PIN             GPIOA, 2U
+typedef Pin<GPIOA_BASE, 2U> UartTxPin;
+#define UART_TX_PIN             PIN_ARGS(UartTxPin)
 // USB UART RX
-#define UART_RX_PIN             GPIOA, 3U
+typedef Pin<GPIOA_BASE, 3U> UartRxPin;
+#define UART_RX_PIN             PIN_ARGS(UartRxPin)
 
 // PORT B
 // Analogue input
-#define ANALOGUE_INPUT_PIN      GPIOB, 1U
+typedef Pin<GPIOB_BASE, 1U> AnalogueInputPin;
+#define ANALOGUE_INPUT_PIN      PIN_ARGS(AnalogueInputPin)
 
 // PORT C
 
 // LED
 // Used for debug - loop timing
-#define LOOPTIME_PIN            GPIOB, 10U
+typedef Pin<GPIOB_BASE, 10U> LoopTimePin;
+#define LOOPTIME_PIN            PIN_ARGS(LoopTimePin)
 // A random pin needed by the CMSIS clock code for some unknown reason
-#define CLOCK_RANDOM_PIN        GPIOC, 15U
+typedef Pin<GPIOC_BASE, 15U> ClockRandomPin;
+#define CLOCK_RANDOM_PIN        PIN_ARGS(ClockRandomPin)
 
 #if defined(WEACT_BLACKPILL_F411CE)
 // The LED on the black pill board
-#define LED_PIN                 GPIOC, 13U
+typedef Pin<GPIOC_BASE, 13U> LedPin;
 #elif defined(ST_NUCLEO_F411RE)
-#define LED_PIN                 GPIOA, 5U
+typedef Pin<GPIOA_BASE, 5U> LedPin;
 #endif
+#define LED_PIN                 PIN_ARGS(LedPin)
+
+static_assert(PinSet<PushButtonPin, TransmitPin, UartTxPin, UartRxPin,
+		AnalogueInputPin, LoopTimePin, ClockRandomPin, LedPin>::Distinct,
+		"A pin has been assigned to more than one function in DefinedPins.h");
 
 #endif
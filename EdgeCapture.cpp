@@ -0,0 +1,164 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// EXTI edge capture for switch inputs
+
+#include "Global.h"
+#include "cmsis.h"
+#include "Clock.h"
+#include "Pins.h"
+#include "Trace.h"
+#include "EdgeCapture.h"
+
+#include <stddef.h> // NULL
+
+// Below the transmitter (which must not be delayed) but above the UART
+#define EDGE_IRQ_PRIORITY 6U
+
+// Written by the interrupts (which all have the same priority so can't
+// interrupt each other) and read by the main loop
+static Edge edge_queue[EDGE_QUEUE_LENGTH];
+static volatile uint8_t edge_head = 0U;
+static volatile uint8_t edge_tail = 0U;
+static volatile uint32_t edge_overflow_count = 0U;
+
+// Ports that have been routed to each EXTI line
+static GPIO_TypeDef *line_ports[16];
+
+static IRQn_Type GetLineIrq(uint8_t line)
+{
+	switch (line) {
+		case 0: return EXTI0_IRQn;
+		case 1: return EXTI1_IRQn;
+		case 2: return EXTI2_IRQn;
+		case 3: return EXTI3_IRQn;
+		case 4: return EXTI4_IRQn;
+		default:
+			if (line <= 9U) {
+				return EXTI9_5_IRQn;
+			}
+			return EXTI15_10_IRQn;
+	}
+}
+
+bool EnableEdgeCapture(GPIO_TypeDef *port, uint8_t pin)
+{
+	if (pin > 15) {
+		return false;
+	}
+	if ((line_ports[pin] != NULL) && (line_ports[pin] != port)) {
+		return false;
+	}
+	line_ports[pin] = port;
+
+	RCC->APB2ENR |= RCC_APB2ENR_SYSCFGEN;
+
+	// Four bits per line in EXTICR: 0 = port A, 1 = port B etc
+	uint32_t port_index = (uint32_t) ((((uintptr_t) port) - GPIOA_BASE) / 0x400U);
+	uint32_t shift = (pin % 4U) * 4U;
+	SYSCFG->EXTICR[pin / 4U] &= ~(0xFU << shift);
+	SYSCFG->EXTICR[pin / 4U] |= (port_index << shift);
+
+	uint32_t mask = 1U << pin;
+	EXTI->RTSR |= mask;
+	EXTI->FTSR |= mask;
+	EXTI->PR = mask;
+	EXTI->IMR |= mask;
+
+	NVIC_SetPriority(GetLineIrq(pin), EDGE_IRQ_PRIORITY);
+	NVIC_EnableIRQ(GetLineIrq(pin));
+	return true;
+}
+
+bool GetNextEdge(Edge *edge)
+{
+	uint8_t tail = edge_tail;
+	if (tail == edge_head) {
+		return false;
+	}
+	*edge = edge_queue[tail];
+	edge_tail = (uint8_t) ((tail + 1U) & (EDGE_QUEUE_LENGTH - 1U));
+	return true;
+}
+
+uint32_t GetEdgeOverflowCount()
+{
+	return edge_overflow_count;
+}
+
+// Queue an edge for each pending line in lines
+static void CaptureEdges(uint32_t lines)
+{
+	uint32_t pending = EXTI->PR & lines;
+	EXTI->PR = pending;
+
+	Timestamp now = GetTimestamp();
+	while (pending != 0U) {
+		uint8_t line = (uint8_t) (31U - __CLZ(pending));
+		pending &= ~(1U << line);
+
+		bool level = ((line_ports[line]->IDR & (1U << line)) != 0U);
+		TRACE(TraceButtonRawEdge, (((uint32_t) line) << 1) | (level ? 1U : 0U));
+
+		uint8_t head = edge_head;
+		uint8_t next = (uint8_t) ((head + 1U) & (EDGE_QUEUE_LENGTH - 1U));
+		if (next == edge_tail) {
+			edge_overflow_count++;
+			continue;
+		}
+		edge_queue[head].time = now;
+		edge_queue[head].pin = line;
+		edge_queue[head].level = level;
+		edge_head = next;
+	}
+}
+
+extern "C" void EXTI0_IRQHandler(void)
+{
+	CaptureEdges(0x0001U);
+}
+
+extern "C" void EXTI1_IRQHandler(void)
+{
+	CaptureEdges(0x0002U);
+}
+
+extern "C" void EXTI2_IRQHandler(void)
+{
+	CaptureEdges(0x0004U);
+}
+
+extern "C" void EXTI3_IRQHandler(void)
+{
+	CaptureEdges(0x0008U);
+}
+
+extern "C" void EXTI4_IRQHandler(void)
+{
+	CaptureEdges(0x0010U);
+}
+
+extern "C" void EXTI9_5_IRQHandler(void)
+{
+	CaptureEdges(0x03E0U);
+}
+
+extern "C" void EXTI15_10_IRQHandler(void)
+{
+	CaptureEdges(0xFC00U);
+}
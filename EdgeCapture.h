@@ -0,0 +1,53 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// EXTI edge capture for switch inputs
+//
+// Instead of polling, a switch input can be set to interrupt on both
+// edges.  The interrupt timestamps each edge into a small queue which
+// the main loop reads with GetNextEdge (see SwitchDebounce), so nothing
+// needs to be read from the port while the input is quiet.
+
+#ifndef EDGECAPTURE_H
+#define EDGECAPTURE_H
+
+#include <stdint.h>
+#include "cmsis.h"
+#include "Clock.h"
+
+typedef struct {
+	Timestamp time;
+	uint8_t pin;    // Pin number (= EXTI line)
+	bool level;     // Input level read in the interrupt (may still be bouncing)
+} Edge;
+
+// Must be a power of two
+#define EDGE_QUEUE_LENGTH 8U
+
+// Route the pin's EXTI line to it and interrupt on both edges.  Returns
+// false if the line is already in use by another port.
+bool EnableEdgeCapture(GPIO_TypeDef *port, uint8_t pin);
+
+// Remove the oldest edge from the queue; returns false if it's empty
+bool GetNextEdge(Edge *edge);
+
+// Edges lost because the queue was full (so the owner should assume that
+// the input may have changed)
+uint32_t GetEdgeOverflowCount();
+
+#endif
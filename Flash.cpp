@@ -0,0 +1,119 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// On-chip flash programming
+
+#include "Global.h"
+#include "cmsis.h"
+#include "Flash.h"
+#include "Clock.h"
+
+#define FLASH_KEY1 ((uint32_t) 0x45670123U)
+#define FLASH_KEY2 ((uint32_t) 0xCDEF89ABU)
+
+#define FLASH_ERROR_FLAGS (FLASH_SR_WRPERR | FLASH_SR_PGAERR | FLASH_SR_PGPERR | FLASH_SR_PGSERR)
+
+// Parallelism of 32 bits (valid for supply voltages of 2.7 V - 3.6 V)
+#define FLASH_PSIZE_WORD (0x2U << FLASH_CR_PSIZE_Pos)
+
+static void UnlockFlash()
+{
+	if ((FLASH->CR & FLASH_CR_LOCK) != 0) {
+		FLASH->KEYR = FLASH_KEY1;
+		FLASH->KEYR = FLASH_KEY2;
+	}
+}
+
+static void LockFlash()
+{
+	FLASH->CR |= FLASH_CR_LOCK;
+}
+
+RAMFUNC static bool WaitForFlash()
+{
+	while ((FLASH->SR & FLASH_SR_BSY) != 0) {
+		// Wait for the operation to complete
+	}
+	if ((FLASH->SR & FLASH_ERROR_FLAGS) != 0) {
+		// Clear the error flags (write 1 to clear)
+		FLASH->SR = FLASH_ERROR_FLAGS;
+		return false;
+	}
+	return true;
+}
+
+// Erasing a 16 kB sector takes a few hundred milliseconds, during which
+// nothing can be read from flash.  This function, the wait loop, the
+// vector table and the SysTick and UART interrupt handlers are in RAM so
+// the millisecond count and serial data keep going; the main loop (and
+// any other interrupt) waits for the erase to finish.  If the SysTick
+// handler was held off anyway (e.g. PROFILING, which records from
+// flash), the lost milliseconds are made up from the cycle counter.
+RAMFUNC bool EraseFlashSector(uint8_t sector)
+{
+	bool result;
+	uint32_t start_ms = GetMillisecondCounter();
+	uint32_t start_cycles = DWT->CYCCNT;
+
+	UnlockFlash();
+	(void) WaitForFlash();
+
+	FLASH->CR = (uint32_t) 0U
+		| FLASH_PSIZE_WORD
+		| FLASH_CR_SER
+		| ((uint32_t) sector << FLASH_CR_SNB_Pos);
+	FLASH->CR |= FLASH_CR_STRT;
+
+	result = WaitForFlash();
+
+	FLASH->CR &= ~(FLASH_CR_SER | FLASH_CR_SNB);
+	LockFlash();
+
+	CatchUpMillisecondCounter(start_ms, DWT->CYCCNT - start_cycles);
+	return result;
+}
+
+bool ProgramFlashWord(uint32_t address, uint32_t data)
+{
+	bool result;
+
+	UnlockFlash();
+	(void) WaitForFlash();
+
+	FLASH->CR = (uint32_t) 0U
+		| FLASH_PSIZE_WORD
+		| FLASH_CR_PG;
+
+	*((volatile uint32_t *) address) = data;
+
+	result = WaitForFlash();
+
+	FLASH->CR &= ~FLASH_CR_PG;
+	LockFlash();
+
+	if (result && (ReadFlashWord(address) != data)) {
+		result = false;
+	}
+	return result;
+}
+
+uint32_t ReadFlashWord(uint32_t address)
+{
+	return *((volatile const uint32_t *) address);
+}
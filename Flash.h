@@ -0,0 +1,45 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// On-chip flash programming
+
+#ifndef FLASH_H
+#define FLASH_H
+
+#include <stdint.h>
+
+// Sectors 1 to 3 (16 kB each) are kept free of code by the linker
+// script so that they can be used for persistent data.  The addresses
+// match those in cmsis/flash_data.h.
+// Sectors 1 and 2 hold the persistent store (see Store.h), used
+// alternately; sector 3 is spare.
+#define STORE_FLASH_SECTOR_A ((uint8_t) 1U)
+#define STORE_FLASH_ADDRESS_A ((uint32_t) 0x08004000U)
+#define STORE_FLASH_SECTOR_B ((uint8_t) 2U)
+#define STORE_FLASH_ADDRESS_B ((uint32_t) 0x08008000U)
+#define FLASH_SECTOR_SIZE ((uint32_t) 0x4000U)
+
+// Value of erased (unprogrammed) flash
+#define FLASH_ERASED_WORD ((uint32_t) 0xFFFFFFFFU)
+
+bool EraseFlashSector(uint8_t sector);
+bool ProgramFlashWord(uint32_t address, uint32_t data);
+uint32_t ReadFlashWord(uint32_t address);
+
+#endif
@@ -0,0 +1,203 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Button gestures
+
+#include "Global.h"
+#include "Clock.h"
+#include "Switches.h"
+#include "Timers.h"
+#include "Settings.h"
+#include "Gestures.h"
+
+// Longest gap between the release of one click and the next press for
+// them to count as a double (or multi) click
+#define MULTI_CLICK_GAP_MS ((uint32_t) 300U)
+#define HOLD_REPEAT_MS ((uint32_t) 500U)
+#define LONG_PRESS_MS GetSetting(DiagnosticHoldSetting)
+
+// Switches that produce gestures, each with a timer for the gesture
+// timings
+static const struct {
+	SwitchName name;
+	TimerName timer;
+} GestureList[] = {
+	{PushButtonSwitch, PushButtonGestureTimer},
+};
+
+#define GESTURE_SWITCH_COUNT ((int) (sizeof(GestureList) / sizeof(GestureList[0])))
+
+static const char *GestureNames[] = {
+	"click",
+	"double-click",
+	"multi-click",
+	"long-press",
+	"hold-repeat",
+};
+
+typedef enum {
+	GestureIdle,
+	GesturePressed,     // Down, not yet a long press
+	GestureReleased,    // Up, waiting to see if there's another click
+	GestureHeld         // Down after a long press
+} GestureState;
+
+static struct {
+	GestureState state;
+	bool last_pressed;
+	uint8_t count;
+	Timestamp press_time;
+} gestures[GESTURE_SWITCH_COUNT];
+
+static GestureEvent gesture_queue[GESTURE_QUEUE_LENGTH];
+static uint8_t gesture_head = 0U;
+static uint8_t gesture_tail = 0U;
+static uint32_t gesture_overflow_count = 0U;
+
+static void QueueGesture(int index, GestureType type, uint8_t count)
+{
+	uint8_t next = (uint8_t) ((gesture_head + 1U) & (GESTURE_QUEUE_LENGTH - 1U));
+	if (next == gesture_tail) {
+		gesture_overflow_count++;
+		return;
+	}
+	gesture_queue[gesture_head].name = GestureList[index].name;
+	gesture_queue[gesture_head].type = type;
+	gesture_queue[gesture_head].count = count;
+	gesture_queue[gesture_head].time = gestures[index].press_time;
+	gesture_head = next;
+}
+
+void InitGestures()
+{
+	for (int i=0;i<GESTURE_SWITCH_COUNT;i++) {
+		gestures[i].state = GestureIdle;
+		gestures[i].last_pressed = GetSwitchState(GestureList[i].name);
+		gestures[i].count = 0U;
+		gestures[i].press_time = GetTimestamp();
+	}
+	ClearGestures();
+}
+
+void UpdateGestures()
+{
+	for (int i=0;i<GESTURE_SWITCH_COUNT;i++) {
+		TimerName timer = GestureList[i].timer;
+		bool pressed = GetSwitchState(GestureList[i].name);
+		bool press = pressed && ( ! gestures[i].last_pressed);
+		bool release = ( ! pressed) && gestures[i].last_pressed;
+		gestures[i].last_pressed = pressed;
+
+		switch (gestures[i].state) {
+			default:
+			case GestureIdle:
+				if (press) {
+					gestures[i].count = 1U;
+					gestures[i].press_time = GetSwitchChangeTime(GestureList[i].name);
+					gestures[i].state = GesturePressed;
+					StartTimer(timer, LONG_PRESS_MS);
+				}
+				break;
+
+			case GesturePressed:
+				if (release) {
+					QueueGesture(i, GestureClick, gestures[i].count);
+					gestures[i].state = GestureReleased;
+					StartTimer(timer, MULTI_CLICK_GAP_MS);
+				}
+				else if (TimerHasExpired(timer)) {
+					QueueGesture(i, GestureLongPress, gestures[i].count);
+					gestures[i].count = 0U;
+					gestures[i].state = GestureHeld;
+					StartPeriodicTimer(timer, HOLD_REPEAT_MS);
+				}
+				else {
+					// Wait
+				}
+				break;
+
+			case GestureReleased:
+				if (press) {
+					if (gestures[i].count < UINT8_MAX) {
+						gestures[i].count++;
+					}
+					gestures[i].press_time = GetSwitchChangeTime(GestureList[i].name);
+					gestures[i].state = GesturePressed;
+					StartTimer(timer, LONG_PRESS_MS);
+				}
+				else if (TimerHasExpired(timer)) {
+					// End of the run of clicks
+					if (gestures[i].count == 2U) {
+						QueueGesture(i, GestureDoubleClick, gestures[i].count);
+					}
+					else if (gestures[i].count > 2U) {
+						QueueGesture(i, GestureMultiClick, gestures[i].count);
+					}
+					else {
+						// Single click (already reported)
+					}
+					gestures[i].state = GestureIdle;
+				}
+				else {
+					// Wait
+				}
+				break;
+
+			case GestureHeld:
+				if (release) {
+					StopTimer(timer);
+					gestures[i].state = GestureIdle;
+				}
+				else if (TimerHasExpired(timer)) {
+					if (gestures[i].count < UINT8_MAX) {
+						gestures[i].count++;
+					}
+					QueueGesture(i, GestureHoldRepeat, gestures[i].count);
+				}
+				else {
+					// Wait
+				}
+				break;
+		}
+	}
+}
+
+bool GetNextGesture(GestureEvent *event)
+{
+	if (gesture_tail == gesture_head) {
+		return false;
+	}
+	*event = gesture_queue[gesture_tail];
+	gesture_tail = (uint8_t) ((gesture_tail + 1U) & (GESTURE_QUEUE_LENGTH - 1U));
+	return true;
+}
+
+void ClearGestures()
+{
+	gesture_tail = gesture_head;
+}
+
+uint32_t GetGestureOverflowCount()
+{
+	return gesture_overflow_count;
+}
+
+const char *GetGestureName(GestureType type)
+{
+	return GestureNames[(int) type];
+}
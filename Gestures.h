@@ -0,0 +1,71 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Button gestures
+//
+// Turns the debounced switch states into a queue of gesture events so
+// that fast presses aren't lost and a single button can do more than one
+// thing.  For each switch in the gesture table:
+//
+//  - GestureClick is queued on each short press (on release), with the
+//    position in the current run of clicks as the count
+//  - when no further press arrives within MULTI_CLICK_GAP_MS, a run of
+//    two clicks also gives GestureDoubleClick and a longer run gives
+//    GestureMultiClick (count = number of clicks)
+//  - holding for the diagnostic_hold_ms setting gives GestureLongPress
+//    (and no click) followed by GestureHoldRepeat every HOLD_REPEAT_MS
+//    until the switch is released
+
+#ifndef GESTURES_H
+#define GESTURES_H
+
+#include <stdint.h>
+#include "Clock.h"
+#include "Switches.h"
+
+typedef enum {
+	GestureClick,
+	GestureDoubleClick,
+	GestureMultiClick,
+	GestureLongPress,
+	GestureHoldRepeat
+} GestureType;
+
+typedef struct {
+	SwitchName name;
+	GestureType type;
+	uint8_t count;  // Clicks so far / in the run, or hold repeats
+	Timestamp time; // Start of the press that produced the event
+} GestureEvent;
+
+// Must be a power of two
+#define GESTURE_QUEUE_LENGTH 8U
+
+void InitGestures();
+void UpdateGestures();
+
+// Remove the oldest event from the queue; returns false if it's empty
+bool GetNextGesture(GestureEvent *event);
+// Discard any queued events
+void ClearGestures();
+// Events discarded because the queue was full
+uint32_t GetGestureOverflowCount();
+
+const char *GetGestureName(GestureType type);
+
+#endif
@@ -24,4 +24,11 @@
 /* Make a macro function with protective braces. */
 #define DO(commands) do {commands} while(false)
 
+/* Put a function in RAM (copied there with the initialised data at
+ * start-up) so that it can run while flash is being erased.  Calls
+ * between RAM and flash are too far for a plain branch: the linker adds
+ * veneers.  Anything a RAM function calls that is still in flash will
+ * stall until the erase has finished. */
+#define RAMFUNC __attribute__((section(".ramfunc"), noinline))
+
 #endif
@@ -0,0 +1,152 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Current-controlled socket state machine
+
+#include "Global.h"
+#include "HysteresisController.h"
+
+typedef enum {
+	CurrentAboveHigh,
+	CurrentAboveLow,
+	CurrentBelowLow,
+	StartDetected,
+	TimerExpired,
+	Always
+} TransitionCondition;
+
+// What to do with the state timer on a transition
+typedef enum {
+	TimerStop,
+	TimerRunOn,
+	TimerTurnOff,
+	TimerConfirm
+} TimerAction;
+
+// For each state, the first transition whose condition is met is taken
+// (so the order within a state matters)
+static const struct {
+	ControllerState from;
+	TransitionCondition condition;
+	ControllerState to;
+	ControllerOutput output;
+	TimerAction timer;
+} TransitionList[] = {
+	// Idle: wait here until the current crosses the upper hysteresis band
+	// and make sure the transmitter is stopped (should be unnecessary,
+	// but doesn't hurt)
+	{IdleState,        CurrentAboveHigh, TurningOnState,   OutputTransmitOn,  TimerStop},
+	{IdleState,        StartDetected,    PredictedOnState, OutputTransmitOn,  TimerConfirm},
+	{IdleState,        Always,           IdleState,        OutputStop,        TimerStop},
+	// Turned on early: carry on if the average confirms the start,
+	// otherwise turn the socket off again (it may already have received
+	// "turn on", so just stopping the transmitter isn't enough)
+	{PredictedOnState, CurrentAboveHigh, TurningOnState,   OutputNone,        TimerStop},
+	{PredictedOnState, TimerExpired,     TurningOffState,  OutputTransmitOff, TimerTurnOff},
+	// Transmitting "turn on" until the current drops below the lower
+	// threshold, then leave the vacuum cleaner running for a little while
+	// to catch the last bits of sawdust
+	{TurningOnState,   CurrentBelowLow,  DelayState,       OutputNone,        TimerRunOn},
+	// If the current doesn't stay low, go back to the turn-on state;
+	// otherwise start sending "turn off" at the end of the run-on time
+	{DelayState,       CurrentAboveLow,  TurningOnState,   OutputNone,        TimerStop},
+	{DelayState,       TimerExpired,     TurningOffState,  OutputTransmitOff, TimerTurnOff},
+	// Current back high: straight back to turning on.  Otherwise, once
+	// "turn off" has been sent for long enough (if it hasn't worked by
+	// now it probably won't!) go back to idle.
+	{TurningOffState,  CurrentAboveHigh, TurningOnState,   OutputTransmitOn,  TimerStop},
+	{TurningOffState,  TimerExpired,     IdleState,        OutputStop,        TimerStop},
+};
+
+#define TRANSITION_COUNT ((int) (sizeof(TransitionList) / sizeof(TransitionList[0])))
+
+void HysteresisController::Init(const HysteresisParameters *parameters)
+{
+	this->parameters = parameters;
+	this->state = IdleState;
+	this->timer_running = false;
+	this->timer_start_ms = 0U;
+	this->timer_duration_ms = 0U;
+}
+
+ControllerOutput HysteresisController::Update(uint32_t now_ms, uint16_t current, bool start_detected)
+{
+	for (int i=0;i<TRANSITION_COUNT;i++) {
+		if (TransitionList[i].from != this->state) {
+			continue;
+		}
+
+		bool met;
+		switch (TransitionList[i].condition) {
+			case CurrentAboveHigh:
+				met = (current > this->parameters->high_threshold);
+				break;
+			case CurrentAboveLow:
+				met = (current > this->parameters->low_threshold);
+				break;
+			case CurrentBelowLow:
+				met = (current < this->parameters->low_threshold);
+				break;
+			case StartDetected:
+				met = start_detected;
+				break;
+			case TimerExpired:
+				// Unsigned subtraction handles counter wrap
+				met = this->timer_running
+					&& ((now_ms - this->timer_start_ms) >= this->timer_duration_ms);
+				break;
+			case Always:
+			default:
+				met = true;
+				break;
+		}
+		if ( ! met) {
+			continue;
+		}
+
+		switch (TransitionList[i].timer) {
+			case TimerRunOn:
+				this->timer_running = true;
+				this->timer_start_ms = now_ms;
+				this->timer_duration_ms = this->parameters->run_on_ms;
+				break;
+			case TimerTurnOff:
+				this->timer_running = true;
+				this->timer_start_ms = now_ms;
+				this->timer_duration_ms = this->parameters->turn_off_ms;
+				break;
+			case TimerConfirm:
+				this->timer_running = true;
+				this->timer_start_ms = now_ms;
+				this->timer_duration_ms = this->parameters->confirm_ms;
+				break;
+			case TimerStop:
+			default:
+				this->timer_running = false;
+				break;
+		}
+		this->state = TransitionList[i].to;
+		return TransitionList[i].output;
+	}
+	return OutputNone;
+}
+
+ControllerState HysteresisController::GetState()
+{
+	return this->state;
+}
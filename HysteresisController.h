@@ -0,0 +1,79 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Current-controlled socket state machine
+//
+// Watches a current reading and decides when the socket should be told
+// to turn on and off: on as soon as the current goes above the upper
+// threshold, then (once it has dropped below the lower threshold) off
+// after a run-on delay.  A detected motor start (see StartDetector.h)
+// turns on straight away, but is withdrawn (by sending "turn off") if
+// the current doesn't then go above the upper threshold within the
+// confirmation time.  The behaviour is defined by a transition table
+// and each instance has its own state and parameters, so several inputs
+// can be controlled independently.  Time and current are passed in, so
+// the controller doesn't depend on the hardware.
+
+#ifndef HYSTERESISCONTROLLER_H
+#define HYSTERESISCONTROLLER_H
+
+#include <stdint.h>
+
+// Don't reorder these: the values are used by trace2json.py
+typedef enum {
+	IdleState,
+	TurningOnState,
+	DelayState,
+	TurningOffState,
+	PredictedOnState
+} ControllerState;
+
+// What the owner should do with the transmitter
+typedef enum {
+	OutputNone,
+	OutputTransmitOn,
+	OutputTransmitOff,
+	OutputStop
+} ControllerOutput;
+
+typedef struct {
+	uint16_t high_threshold; // Current that turns the socket on
+	uint16_t low_threshold;  // Current below which the run-on starts
+	uint32_t run_on_ms;      // Time below the low threshold before turning off
+	uint32_t turn_off_ms;    // How long to send "turn off" for
+	uint32_t confirm_ms;     // Time allowed for a detected start to be confirmed
+} HysteresisParameters;
+
+class HysteresisController
+{
+	public:
+		// The parameters are read on every update so can be changed
+		// while running
+		void Init(const HysteresisParameters *parameters);
+		ControllerOutput Update(uint32_t now_ms, uint16_t current, bool start_detected);
+		ControllerState GetState();
+
+	private:
+		const HysteresisParameters *parameters;
+		ControllerState state;
+		bool timer_running;
+		uint32_t timer_start_ms;
+		uint32_t timer_duration_ms;
+};
+
+#endif
@@ -0,0 +1,109 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Main loop deadline monitoring
+
+#include "Global.h"
+#include "Clock.h"
+#include "LoopMonitor.h"
+
+static uint32_t loop_start_tick;
+// Task during which the tick changed (only valid if tick_changed)
+static TaskName overrun_stage;
+static bool tick_changed;
+
+static uint32_t overrun_count = 0U;
+static uint32_t missed_tick_count = 0U;
+static LoopOverrun worst_overrun;
+static LoopOverrun last_overrun;
+
+void StartLoopMonitor()
+{
+	loop_start_tick = GetMillisecondCounter();
+	tick_changed = false;
+}
+
+// Called after each task so that an overrun can be blamed on the task
+// that was running when the next tick arrived
+void EndLoopStage(TaskName stage)
+{
+	if (( ! tick_changed) && (GetMillisecondCounter() != loop_start_tick)) {
+		tick_changed = true;
+		overrun_stage = stage;
+	}
+}
+
+void EndLoopMonitor()
+{
+	uint32_t end_tick;
+	uint32_t cycles_into_tick;
+	uint32_t ticks;
+	uint32_t excess_us;
+
+	if ( ! tick_changed) {
+		return;
+	}
+
+	GetTickTime(&end_tick, &cycles_into_tick);
+	ticks = end_tick - loop_start_tick;
+
+	// Time past the end of the tick in which the loop started: whole
+	// ticks missed plus the part of the current tick used so far
+	excess_us = ((ticks - 1U) * 1000U) + (cycles_into_tick / GetClockSpeedMHz());
+
+	overrun_count++;
+	missed_tick_count += ticks;
+
+	last_overrun.timestamp = end_tick;
+	last_overrun.excess_us = excess_us;
+	last_overrun.stage = overrun_stage;
+	if (excess_us >= worst_overrun.excess_us) {
+		worst_overrun = last_overrun;
+	}
+}
+
+uint32_t GetLoopOverrunCount()
+{
+	return overrun_count;
+}
+
+uint32_t GetMissedTickCount()
+{
+	return missed_tick_count;
+}
+
+const LoopOverrun *GetWorstLoopOverrun()
+{
+	return &worst_overrun;
+}
+
+const LoopOverrun *GetLastLoopOverrun()
+{
+	return &last_overrun;
+}
+
+void ResetLoopMonitor()
+{
+	overrun_count = 0U;
+	missed_tick_count = 0U;
+	worst_overrun.timestamp = 0U;
+	worst_overrun.excess_us = 0U;
+	worst_overrun.stage = TimersTask;
+	last_overrun = worst_overrun;
+}
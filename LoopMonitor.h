@@ -0,0 +1,49 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Main loop deadline monitoring
+//
+// The main loop is expected to finish well within one millisecond tick.
+// If it doesn't, the next tick's loop is skipped (the ADC sample cadence
+// stretches etc), so overruns are counted here along with the worst
+// excess time and the task that was running when the tick fired.
+
+#ifndef LOOPMONITOR_H
+#define LOOPMONITOR_H
+
+#include <stdint.h>
+#include "Scheduler.h"
+
+typedef struct {
+	uint32_t timestamp; // Millisecond counter at the end of the loop
+	uint32_t excess_us; // Time past the end of the tick
+	TaskName stage;     // Task running when the tick fired
+} LoopOverrun;
+
+void StartLoopMonitor();
+void EndLoopStage(TaskName stage);
+void EndLoopMonitor();
+
+uint32_t GetLoopOverrunCount();
+uint32_t GetMissedTickCount();
+const LoopOverrun *GetWorstLoopOverrun();
+const LoopOverrun *GetLastLoopOverrun();
+void ResetLoopMonitor();
+
+#endif
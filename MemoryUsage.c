@@ -0,0 +1,134 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Heap and stack usage
+
+#ifndef NO_HEAP
+#include <malloc.h> // malloc_usable_size, mallinfo
+#endif
+
+#include "cmsis.h"
+#include "MemoryUsage.h"
+
+// Stack region from the linker script (see .stack_dummy)
+extern uint32_t __StackLimit;
+extern uint32_t __StackTop;
+
+static HeapStatistics heap_statistics = {0};
+static bool initialisation_complete = false;
+
+#ifndef NO_HEAP
+size_t GetBlockSize(void *ptr)
+{
+	if (ptr == NULL) {
+		return 0U;
+	}
+	return malloc_usable_size(ptr);
+}
+
+void RecordAllocation(void *ptr, size_t requested)
+{
+	if (ptr == NULL) {
+		if (requested != 0U) {
+			heap_statistics.failure_count++;
+		}
+		return;
+	}
+
+	uint32_t size = (uint32_t) GetBlockSize(ptr);
+
+	heap_statistics.allocation_count++;
+	if (initialisation_complete) {
+		heap_statistics.post_init_count++;
+	}
+	heap_statistics.current_bytes += size;
+	if (heap_statistics.current_bytes > heap_statistics.peak_bytes) {
+		heap_statistics.peak_bytes = heap_statistics.current_bytes;
+	}
+	if (size > heap_statistics.largest_block) {
+		heap_statistics.largest_block = size;
+	}
+}
+
+// Size zero means there was no block (e.g. free(NULL))
+void RecordFree(size_t size)
+{
+	if (size == 0U) {
+		return;
+	}
+
+	heap_statistics.free_count++;
+	heap_statistics.current_bytes -= (uint32_t) size;
+}
+#endif
+
+void SetInitialisationComplete(void)
+{
+	initialisation_complete = true;
+}
+
+const HeapStatistics *GetHeapStatistics(void)
+{
+	return &heap_statistics;
+}
+
+uint32_t GetHeapArenaSize(void)
+{
+#ifdef NO_HEAP
+	// No heap in static builds
+	return 0U;
+#else
+	struct mallinfo info = mallinfo();
+	return (uint32_t) info.arena;
+#endif
+}
+
+// Leave a few words below the current stack pointer alone in case the
+// compiler has put anything there
+#define PAINT_MARGIN_WORDS 16
+
+void PaintStack(void)
+{
+	uint32_t *end = ((uint32_t *) __get_MSP()) - PAINT_MARGIN_WORDS;
+
+	for (uint32_t *p = &__StackLimit; p < end; p++) {
+		*p = STACK_PAINT_PATTERN;
+	}
+}
+
+uint32_t GetStackSize(void)
+{
+	return (uint32_t) ((&__StackTop - &__StackLimit) * sizeof(uint32_t));
+}
+
+uint32_t GetStackHighWaterMark(void)
+{
+	const uint32_t *p = &__StackLimit;
+
+	// The stack grows downwards, so the first word (from the bottom) that
+	// isn't the paint pattern is the deepest point reached
+	while ((p < &__StackTop) && (*p == STACK_PAINT_PATTERN)) {
+		p++;
+	}
+	return (uint32_t) ((&__StackTop - p) * sizeof(uint32_t));
+}
+
+bool StackOverflowDetected(void)
+{
+	return (__StackLimit != STACK_PAINT_PATTERN);
+}
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Heap and stack usage
+//
+// The heap figures are gathered by the malloc wrappers in
+// cmsis_required.c.  The stack is painted with a known pattern before
+// main runs (also in cmsis_required.c) and the deepest point reached is
+// found by scanning for the first overwritten word.  This file is
+// compiled as C, so keep it free of C++.
+
+#ifndef MEMORYUSAGE_H
+#define MEMORYUSAGE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Pattern written over the unused stack at start-up
+#define STACK_PAINT_PATTERN ((uint32_t) 0xC5C5C5C5U)
+
+typedef struct {
+	uint32_t current_bytes;       // Bytes currently allocated
+	uint32_t peak_bytes;          // Highest value of current_bytes
+	uint32_t largest_block;       // Largest single allocation
+	uint32_t allocation_count;    // Successful allocations (including realloc)
+	uint32_t free_count;          // Blocks freed
+	uint32_t failure_count;       // Allocations that returned NULL
+	uint32_t post_init_count;     // Allocations after SetInitialisationComplete
+} HeapStatistics;
+
+// Called by the malloc wrappers.  Sizes are the usable size of each block
+// (which may be a little larger than requested) so that frees can be
+// matched up without storing anything extra.
+size_t GetBlockSize(void *ptr);
+void RecordAllocation(void *ptr, size_t requested);
+void RecordFree(size_t size);
+
+// Called once everything is set up: any later allocation is counted
+// separately as there shouldn't be any on the main loop paths
+void SetInitialisationComplete(void);
+
+const HeapStatistics *GetHeapStatistics(void);
+// Bytes obtained from the system by malloc (including its overheads)
+uint32_t GetHeapArenaSize(void);
+
+// Called before main: fills the unused part of the stack region
+void PaintStack(void);
+uint32_t GetStackSize(void);
+// Deepest stack usage seen so far (bytes)
+uint32_t GetStackHighWaterMark(void);
+// True if the bottom of the stack region has been overwritten (the stack
+// may have run into the heap)
+bool StackOverflowDetected(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -137,11 +137,13 @@ void SetPinState(GPIO_TypeDef *port, uint8_t pin, bool high)
 	if (pin > 15) {
 		return;
 	}
+	// BSRR rather than read-modify-write of ODR so that other pins on the
+	// port can safely be changed from interrupts
 	if (high) {
-		port->ODR |= (0x1U << pin);
+		port->BSRR = (0x1U << pin);
 	}
 	else {
-		port->ODR &= ~(0x1U << pin);
+		port->BSRR = (0x1U << (pin + 16U));
 	}
 }
 
@@ -164,5 +166,7 @@ void TogglePin(GPIO_TypeDef *port, uint8_t pin)
 	if (pin > 15) {
 		return;
 	}
-	port->ODR ^= (0x1U << pin);
+	uint32_t mask = 0x1U << pin;
+	uint32_t odr = port->ODR;
+	port->BSRR = ((odr & mask) << 16) | ((~odr) & mask);
 }
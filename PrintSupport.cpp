@@ -19,26 +19,191 @@
 // Functions required to make printf and suchlike work
 
 #include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
 #include <errno.h>
 #include <sys/unistd.h> // STDOUT_FILENO, STDERR_FILENO
 
 #include "Global.h"
 #include "Uart.h"
 #include "CircularBuffer.h"
+#include "Clock.h"
 #include "tinyprintf.h"
 
+#include "PrintSupport.h"
+
 // UART to make printf etc work
 static Uart uart;
 
+// With the OverflowBlock policy, the longest we'll wait for space in the
+// outgoing buffer before giving up and dropping the data
+#define BLOCK_TIMEOUT_MS ((uint32_t) 20U)
+
+// Total number of bytes passed to the outgoing buffer (wraps); used to
+// measure how much UART bandwidth the debug output is using
+static uint32_t outgoing_byte_count = 0U;
+
+// Number of bufprintf messages discarded because they didn't fit
+static uint32_t truncated_message_count = 0U;
+
+// Destination for bufprintf: the free space in the outgoing buffer
+typedef struct {
+	DTYPE *first;
+	uint16_t first_length;
+	DTYPE *second;
+	uint16_t second_length;
+	uint16_t count;
+} SpanSink;
+
+// The timeout applies to a whole message rather than to each wait, so
+// a message that's sent a character at a time can't block for the
+// timeout once per character.  printf has no end-of-message call, so a
+// message ends at the start of the next whole message or when the main
+// loop next services the UART.
+static bool message_waiting = false;
+static uint32_t message_wait_start = 0U;
+
+static void StartMessage() {
+	message_waiting = false;
+}
+
+// If the outgoing stream is set to block, keep sending until there's
+// space for the requested number of bytes (or until the message has
+// used up its timeout)
+static void WaitForSpace(uint16_t needed) {
+	if ((uart.outgoingBuffer->getOverflowPolicy() != OverflowBlock)
+			|| (uart.outgoingBuffer->getSpace() >= needed)) {
+		return;
+	}
+	if ( ! message_waiting) {
+		message_waiting = true;
+		message_wait_start = GetMillisecondCounter();
+	}
+	while ((uart.outgoingBuffer->getSpace() < needed)
+			&& ( ! MillisecondsHaveElapsed(message_wait_start, BLOCK_TIMEOUT_MS))) {
+		uart.Update();
+	}
+}
+
+// Apply the outgoing stream's overflow policy so that (if possible)
+// there's space for the requested number of bytes
+static void MakeSpace(uint16_t needed) {
+	uint16_t space = uart.outgoingBuffer->getSpace();
+	if (space >= needed) {
+		return;
+	}
+	switch (uart.outgoingBuffer->getOverflowPolicy()) {
+		case OverflowBlock:
+			WaitForSpace(needed);
+			break;
+		case OverflowDropOldest:
+			uart.outgoingBuffer->discardEntries(needed - space);
+			break;
+		case OverflowDropNewest:
+		default:
+			break;
+	}
+}
+
 void putcfunc(void *dummy, char ch) {
 	(void) dummy;
+	WaitForSpace(1);
 	uart.outgoingBuffer->addEntry((DTYPE) ch);
+	outgoing_byte_count++;
 }
 
 void printchar(char ch) {
 	putcfunc(NULL, ch);
 }
 
+static void spanputcfunc(void *data, char ch) {
+	SpanSink *sink = (SpanSink *) data;
+	if (sink->count < sink->first_length) {
+		sink->first[sink->count] = (DTYPE) ch;
+	}
+	else if ((uint16_t) (sink->count - sink->first_length) < sink->second_length) {
+		sink->second[sink->count - sink->first_length] = (DTYPE) ch;
+	}
+	else {
+		// Out of space: keep counting so that the caller can tell
+	}
+	if (sink->count < UINT16_MAX) {
+		sink->count++;
+	}
+}
+
+/*
+ * printf replacement that formats straight into the free space in the
+ * outgoing buffer and then commits the whole message at once (rather
+ * than adding one character at a time).  If the message doesn't fit,
+ * the outgoing stream's overflow policy is applied and the message is
+ * formatted again.  If it still doesn't fit, none of it is sent: the
+ * return value is -1 and the truncation counter is incremented.
+ * Otherwise, returns the number of characters sent.
+ */
+int bufprintf(const char *fmt, ...) {
+	SpanSink sink;
+	va_list va;
+
+	StartMessage();
+	uart.outgoingBuffer->getWriteSpans(&sink.first, &sink.first_length,
+			&sink.second, &sink.second_length);
+	sink.count = 0;
+
+	va_start(va, fmt);
+	tfp_format(&sink, spanputcfunc, fmt, va);
+	va_end(va);
+
+	if ((sink.count > (sink.first_length + sink.second_length))
+			&& (sink.count <= uart.outgoingBuffer->getCapacity())) {
+		MakeSpace(sink.count);
+
+		uart.outgoingBuffer->getWriteSpans(&sink.first, &sink.first_length,
+				&sink.second, &sink.second_length);
+		if (sink.count <= (sink.first_length + sink.second_length)) {
+			sink.count = 0;
+			va_start(va, fmt);
+			tfp_format(&sink, spanputcfunc, fmt, va);
+			va_end(va);
+		}
+	}
+
+	if (sink.count > (sink.first_length + sink.second_length)) {
+		uart.outgoingBuffer->recordDrops(sink.count);
+		truncated_message_count++;
+		return -1;
+	}
+
+	uart.outgoingBuffer->commitEntries(sink.count);
+	outgoing_byte_count += sink.count;
+	return sink.count;
+}
+
+uint32_t GetTruncatedMessageCount() {
+	return truncated_message_count;
+}
+
+CircularBuffer *GetStreamBuffer(StreamName name) {
+	if (name == IncomingStream) {
+		return uart.incomingBuffer;
+	}
+	else {
+		return uart.outgoingBuffer;
+	}
+}
+
+uint16_t GetIsrRxHighWaterMark() {
+	return uart.GetIsrRxHighWaterMark();
+}
+
+uint16_t GetIsrTxHighWaterMark() {
+	return uart.GetIsrTxHighWaterMark();
+}
+
+uint32_t GetIsrRxOverrunCount() {
+	return uart.GetIsrRxOverrunCount();
+}
+
 bool bytes_waiting() {
 	return uart.incomingBuffer->containsData();
 }
@@ -47,22 +212,57 @@ DTYPE get_incoming_byte() {
 	return uart.incomingBuffer->getEntry();
 }
 
+uint32_t GetOutgoingByteCount() {
+	return outgoing_byte_count;
+}
+
+uint16_t get_outgoing_space() {
+	return uart.outgoingBuffer->getSpace();
+}
+
+bool outgoing_complete() {
+	return uart.IsTransmitIdle();
+}
+
+bool IsPrintSupportIdle() {
+	return uart.IsIdle();
+}
+
+bool RequestBaudRate(uint32_t baud) {
+	return uart.RequestBaudRate(baud);
+}
+
+void ConfirmBaudRate() {
+	uart.ConfirmBaudRate();
+}
+
+uint32_t GetBaudRate() {
+	return uart.GetBaudRate();
+}
+
 void InitPrintSupport()
 {
+#ifndef NO_HEAP
+	// stdio isn't used by this code, but make sure that anything that
+	// does use it isn't buffered (stdio can't be linked into NO_HEAP
+	// builds as it needs malloc)
 	setbuf(stdout, NULL);
+#endif
 	uart.Init();
 	init_printf(NULL, &putcfunc);
 }
 
 void UpdatePrintSupport()
 {
+	StartMessage();
 	uart.Update();
 }
 
 void putstring(const char *data) {
 	int index = 0;
+	StartMessage();
 	while (data[index]) {
-		putchar(data[index]);
+		printchar(data[index]);
 		index++;
 	}
 }
@@ -73,7 +273,9 @@ void putstring(const char *data) {
 extern "C" int fputc(int ch, FILE *f)
 {
 	/* Write a character to the USART */
+	WaitForSpace(1);
 	uart.outgoingBuffer->addEntry((DTYPE) ch);
+	outgoing_byte_count++;
 
 	return ch;
 }
@@ -85,14 +287,37 @@ extern "C" int _write(int file, char *data, int len)
 		errno = EBADF;
 		return -1;
 	}
-	int writeCount = 0;
-	int space = uart.outgoingBuffer->getSpace();
+	DTYPE *first;
+	DTYPE *second;
+	uint16_t firstLength;
+	uint16_t secondLength;
+	int writeCount;
+	uint16_t capacity = uart.outgoingBuffer->getCapacity();
 
-	while ((len > 0) && (space > 0)) {
-		uart.outgoingBuffer->addEntry((DTYPE) data[writeCount]);
-		writeCount++;
-		space--;
-		len--;
+	StartMessage();
+
+	// Anything bigger than the whole buffer can't be sent in one go
+	MakeSpace((len < capacity) ? (uint16_t) len : capacity);
+
+	// Copy as much as will fit directly into the outgoing buffer
+	uart.outgoingBuffer->getWriteSpans(&first, &firstLength, &second, &secondLength);
+	if (len <= firstLength) {
+		memcpy(first, data, len);
+		writeCount = len;
+	}
+	else {
+		memcpy(first, data, firstLength);
+		writeCount = len - firstLength;
+		if (writeCount > secondLength) {
+			writeCount = secondLength;
+		}
+		memcpy(second, &data[firstLength], writeCount);
+		writeCount += firstLength;
+	}
+	uart.outgoingBuffer->commitEntries((uint16_t) writeCount);
+	outgoing_byte_count += (uint32_t) writeCount;
+	if (writeCount < len) {
+		uart.outgoingBuffer->recordDrops((uint16_t) (len - writeCount));
 	}
 
 	return writeCount;
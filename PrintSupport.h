@@ -23,11 +23,32 @@
 
 #include "CircularBuffer.h"
 
+typedef enum {
+	OutgoingStream,
+	IncomingStream
+} StreamName;
+
 void InitPrintSupport();
 void UpdatePrintSupport();
 void putstring(const char *data);
 void printchar(char ch);
+int bufprintf(const char *fmt, ...) __attribute__((format(__printf__, 1, 2)));
+uint32_t GetTruncatedMessageCount();
+
+// Buffer statistics and overflow policies
+CircularBuffer *GetStreamBuffer(StreamName name);
+uint16_t GetIsrRxHighWaterMark();
+uint16_t GetIsrTxHighWaterMark();
+uint32_t GetIsrRxOverrunCount();
 bool bytes_waiting();
 DTYPE get_incoming_byte();
+uint32_t GetOutgoingByteCount();
+uint16_t get_outgoing_space();
+bool outgoing_complete();
+// True if the UART has nothing to do (for tickless idle)
+bool IsPrintSupportIdle();
+bool RequestBaudRate(uint32_t baud);
+void ConfirmBaudRate();
+uint32_t GetBaudRate();
 
 #endif
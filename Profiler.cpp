@@ -0,0 +1,115 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Cycle-count profiling of the scheduler tasks and interrupts
+
+#include "Global.h"
+#include "Profiler.h"
+
+#ifdef PROFILING
+
+#include <assert.h>
+
+// List of profiled functions
+static const struct {
+	ProfilePoint name;
+	const char *displayname;
+} ProfileList[PROFILE_POINT_COUNT] = {
+	{TimersProfile,         "UpdateTimers"},
+	{SwitchesProfile,       "UpdateSwitches"},
+	{GesturesProfile,       "UpdateGestures"},
+	{AnalogueProfile,       "UpdateAnalogue"},
+	{ApplicationProfile,    "UpdateApplication"},
+	{PrintSupportProfile,   "UpdatePrintSupport"},
+	{DebugProfile,          "UpdateDebug"},
+	{DebugScreenProfile,    "UpdateDebugScreen"},
+	{UsageProfile,          "UpdateUsage"},
+	{StoreProfile,          "UpdateStore"},
+	{SysTickProfile,        "SysTick_Handler"},
+	{TransmitterIsrProfile, "TIM2_IRQHandler"},
+	{UartIsrProfile,        "UART_IRQHandler"},
+};
+
+static ProfileStatistics statistics[PROFILE_POINT_COUNT];
+
+void InitProfiler()
+{
+	for (int i=0;i<PROFILE_POINT_COUNT;i++) {
+		// Check that the points are in the right order in the array
+		assert(ProfileList[i].name == ((int) i));
+	}
+
+	ResetProfiler();
+
+	// Enable the DWT cycle counter (counts at the core clock)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0U;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Each point is only ever recorded from one context (the main loop or a
+// single interrupt) so no locking is needed here.  The reports may be
+// very slightly inconsistent if an interrupt updates a point while it's
+// being printed.
+void RecordProfile(ProfilePoint point, uint32_t start_cycles)
+{
+	// Unsigned subtraction handles counter wrap
+	uint32_t cycles = DWT->CYCCNT - start_cycles;
+	ProfileStatistics *stats = &statistics[(int) point];
+	uint32_t bucket = 0U;
+
+	if (cycles != 0U) {
+		bucket = 31U - __CLZ(cycles);
+	}
+
+	stats->count++;
+	stats->total += cycles;
+	if (cycles < stats->minimum) {
+		stats->minimum = cycles;
+	}
+	if (cycles > stats->maximum) {
+		stats->maximum = cycles;
+	}
+	stats->histogram[bucket]++;
+}
+
+void ResetProfiler()
+{
+	for (int i=0;i<PROFILE_POINT_COUNT;i++) {
+		statistics[i].count = 0U;
+		statistics[i].minimum = UINT32_MAX;
+		statistics[i].maximum = 0U;
+		statistics[i].total = 0U;
+		for (int b=0;b<PROFILE_BUCKET_COUNT;b++) {
+			statistics[i].histogram[b] = 0U;
+		}
+	}
+}
+
+const ProfileStatistics *GetProfileStatistics(ProfilePoint point)
+{
+	return &statistics[(int) point];
+}
+
+const char *GetProfileName(ProfilePoint point)
+{
+	return ProfileList[(int) point].displayname;
+}
+
+#endif
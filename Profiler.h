@@ -0,0 +1,78 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Cycle-count profiling of the scheduler tasks and interrupts
+//
+// Build with -D PROFILING (e.g. python compile.py ... -D PROFILING) to
+// enable; otherwise the PROFILE_* macros compile to nothing.
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdint.h>
+
+typedef enum _ProfilePoints
+{
+	TimersProfile,
+	SwitchesProfile,
+	GesturesProfile,
+	AnalogueProfile,
+	ApplicationProfile,
+	PrintSupportProfile,
+	DebugProfile,
+	DebugScreenProfile,
+	UsageProfile,
+	StoreProfile,
+	SysTickProfile,
+	TransmitterIsrProfile,
+	UartIsrProfile,
+	LastProfileIndex = UartIsrProfile
+} ProfilePoint;
+
+#define PROFILE_POINT_COUNT (((int) LastProfileIndex)+1)
+
+// One histogram bucket per power of two: bucket n counts durations of
+// 2^n to 2^(n+1)-1 cycles (bucket 0 also counts zero)
+#define PROFILE_BUCKET_COUNT 32
+
+#ifdef PROFILING
+#include "cmsis.h"
+
+typedef struct {
+	uint32_t count;
+	uint32_t minimum;
+	uint32_t maximum;
+	uint64_t total;
+	uint32_t histogram[PROFILE_BUCKET_COUNT];
+} ProfileStatistics;
+
+void InitProfiler();
+void RecordProfile(ProfilePoint point, uint32_t start_cycles);
+void ResetProfiler();
+const ProfileStatistics *GetProfileStatistics(ProfilePoint point);
+const char *GetProfileName(ProfilePoint point);
+
+#define PROFILE_START(var) uint32_t var = DWT->CYCCNT
+#define PROFILE_END(point, var) RecordProfile(point, var)
+#else
+#define PROFILE_START(var)
+#define PROFILE_END(point, var)
+#endif
+
+#endif
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Run-on delay policy
+
+#include "Global.h"
+#include "Analogue.h"
+#include "Settings.h"
+#include "RunOnPolicy.h"
+
+// Charge is in ADC units x ms: this is 100 ADC unit seconds
+#define CHARGE_STEP ((uint64_t) 100000U)
+
+uint32_t GetRunOnDelay(const RunStatistics *statistics)
+{
+	if (GetSetting(AdaptiveRunOnSetting) == 0U) {
+		return GetSetting(RunOnDelaySetting);
+	}
+
+	uint32_t minimum = GetSetting(RunOnMinimumSetting);
+	uint32_t maximum = GetSetting(RunOnMaximumSetting);
+	if (maximum < minimum) {
+		maximum = minimum;
+	}
+
+	// Worked in 64 bits so that a long run can't overflow before the
+	// limit is applied
+	uint64_t delay = minimum;
+	delay += (((uint64_t) statistics->on_time_ms) * GetSetting(RunOnPerSecondSetting)) / 1000U;
+	delay += (statistics->charge * GetSetting(RunOnPerChargeSetting)) / CHARGE_STEP;
+
+	if (delay > maximum) {
+		return maximum;
+	}
+	return (uint32_t) delay;
+}
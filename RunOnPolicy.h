@@ -0,0 +1,38 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Run-on delay policy
+//
+// After sanding, dust keeps settling for a while, but after a short trim
+// cut there's little point running the vacuum for long.  With the
+// adaptive_run_on setting on, the run-on delay is
+//
+//   run_on_min_ms + (run_on_per_s x seconds the tool ran)
+//                 + (run_on_per_charge x charge / 100 ADC unit seconds)
+//
+// limited to run_on_max_ms.  Otherwise it's the fixed run_on_ms.
+
+#ifndef RUNONPOLICY_H
+#define RUNONPOLICY_H
+
+#include <stdint.h>
+#include "Analogue.h"
+
+uint32_t GetRunOnDelay(const RunStatistics *statistics);
+
+#endif
@@ -0,0 +1,218 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cooperative main loop scheduler
+
+#include "Global.h"
+#include "cmsis.h"
+#include "Clock.h"
+#include "Scheduler.h"
+#include "LoopMonitor.h"
+#include "Profiler.h"
+
+#include "Timers.h"
+#include "Switches.h"
+#include "Gestures.h"
+#include "Analogue.h"
+#include "Application.h"
+#include "PrintSupport.h"
+#include "Debug.h"
+#include "Usage.h"
+#include "Store.h"
+
+#include <assert.h>
+
+// Time in each tick that the tasks are expected to fit into; the rest is
+// left for the interrupts
+#define TICK_BUDGET_US ((uint32_t) 600U)
+
+// List of tasks (in the same order as the enumeration).  The budgets are
+// starting points: see the "tasks" debug command for the actual times.
+static const struct {
+	TaskName name;
+	void (*function)();
+	uint32_t period_ms;
+	uint32_t phase_ms;
+	TaskPriority priority;
+	uint32_t budget_us;
+	ProfilePoint profile;
+	const char *displayname;
+} TaskList[TASK_COUNT] = {
+	{TimersTask,       UpdateTimers,       1U,   0U,  CriticalPriority, 20U,  TimersProfile,       "UpdateTimers"},
+	{SwitchesTask,     UpdateSwitches,     1U,   0U,  CriticalPriority, 20U,  SwitchesProfile,     "UpdateSwitches"},
+	{GesturesTask,     UpdateGestures,     1U,   0U,  CriticalPriority, 10U,  GesturesProfile,     "UpdateGestures"},
+	{AnalogueTask,     UpdateAnalogue,     1U,   0U,  CriticalPriority, 30U,  AnalogueProfile,     "UpdateAnalogue"},
+	{ApplicationTask,  UpdateApplication,  1U,   0U,  CriticalPriority, 30U,  ApplicationProfile,  "UpdateApplication"},
+	{PrintSupportTask, UpdatePrintSupport, 1U,   0U,  HighPriority,     50U,  PrintSupportProfile, "UpdatePrintSupport"},
+	{DebugTask,        UpdateDebug,        1U,   0U,  NormalPriority,   150U, DebugProfile,        "UpdateDebug"},
+	{DebugScreenTask,  UpdateDebugScreen,  UI_INTERVAL_MS, 50U, LowPriority,      300U, DebugScreenProfile,  "UpdateDebugScreen"},
+	{UsageTask,        UpdateUsage,        USAGE_SAMPLE_MS, 25U, LowPriority,      30U,  UsageProfile,        "UpdateUsage"},
+	{StoreTask,        UpdateStore,        1U,   0U,  LowPriority,      100U, StoreProfile,        "UpdateStore"},
+};
+
+static struct {
+	uint32_t next_release; // Tick on which the task is next due
+	bool pending;          // Due but not yet run
+	bool deferred;         // Already put off once
+} tasks[TASK_COUNT];
+
+static TaskStatistics statistics[TASK_COUNT];
+
+// Task indices in priority order
+static uint8_t run_order[TASK_COUNT];
+
+void InitScheduler()
+{
+	uint32_t now = GetMillisecondCounter();
+
+	for (int i=0;i<TASK_COUNT;i++) {
+		// Check that the tasks are in the right order in the array
+		assert(TaskList[i].name == ((int) i));
+		assert(TaskList[i].period_ms > 0U);
+
+		tasks[i].next_release = now + TaskList[i].phase_ms;
+		tasks[i].pending = false;
+		tasks[i].deferred = false;
+
+		// Insertion sort by priority (keeping the table order otherwise)
+		int j = i;
+		while ((j > 0) && (TaskList[run_order[j-1]].priority > TaskList[i].priority)) {
+			run_order[j] = run_order[j-1];
+			j--;
+		}
+		run_order[j] = (uint8_t) i;
+	}
+
+	ResetTaskStatistics();
+
+	// The run times are measured with the DWT cycle counter
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+}
+
+// Mark the tasks that have become due.  If ticks have been missed (or
+// skipped by tickless idle), a task is only run once and its next release
+// stays in phase.
+static void ReleaseTasks(uint32_t now)
+{
+	for (int i=0;i<TASK_COUNT;i++) {
+		int32_t late = (int32_t) (now - tasks[i].next_release);
+		if (late >= 0) {
+			uint32_t period = TaskList[i].period_ms;
+			tasks[i].pending = true;
+			tasks[i].next_release += period * ((((uint32_t) late) / period) + 1U);
+		}
+	}
+}
+
+void RunScheduler()
+{
+	uint32_t tick_start = DWT->CYCCNT;
+	uint32_t cycles_per_us = GetClockSpeedMHz();
+
+	ReleaseTasks(GetMillisecondCounter());
+
+	for (int r=0;r<TASK_COUNT;r++) {
+		uint8_t i = run_order[r];
+		if ( ! tasks[i].pending) {
+			continue;
+		}
+
+		uint32_t used_us = (DWT->CYCCNT - tick_start) / cycles_per_us;
+		if ((TaskList[i].priority != CriticalPriority)
+				&& ( ! tasks[i].deferred)
+				&& ((used_us + TaskList[i].budget_us) > TICK_BUDGET_US)) {
+			tasks[i].deferred = true;
+			statistics[i].deferrals++;
+			continue;
+		}
+
+		uint32_t start = DWT->CYCCNT;
+		TaskList[i].function();
+		uint32_t cycles = DWT->CYCCNT - start;
+#ifdef PROFILING
+		RecordProfile(TaskList[i].profile, start);
+#endif
+		EndLoopStage((TaskName) i);
+
+		tasks[i].pending = false;
+		tasks[i].deferred = false;
+		statistics[i].runs++;
+		statistics[i].total_cycles += cycles;
+		if (cycles > statistics[i].maximum_cycles) {
+			statistics[i].maximum_cycles = cycles;
+		}
+		if (cycles > (TaskList[i].budget_us * cycles_per_us)) {
+			statistics[i].overruns++;
+		}
+	}
+}
+
+uint32_t GetTimeToNextTask(uint32_t limit)
+{
+	uint32_t now = GetMillisecondCounter();
+	uint32_t result = limit;
+
+	for (int i=0;i<TASK_COUNT;i++) {
+		if (TaskList[i].period_ms <= 1U) {
+			continue;
+		}
+		if (tasks[i].pending) {
+			return 0U;
+		}
+		int32_t remaining = (int32_t) (tasks[i].next_release - now);
+		if (remaining <= 0) {
+			return 0U;
+		}
+		if (((uint32_t) remaining) < result) {
+			result = (uint32_t) remaining;
+		}
+	}
+	return result;
+}
+
+const TaskStatistics *GetTaskStatistics(TaskName task)
+{
+	return &statistics[(int) task];
+}
+
+const char *GetTaskName(TaskName task)
+{
+	return TaskList[(int) task].displayname;
+}
+
+uint32_t GetTaskPeriod(TaskName task)
+{
+	return TaskList[(int) task].period_ms;
+}
+
+uint32_t GetTaskBudget(TaskName task)
+{
+	return TaskList[(int) task].budget_us;
+}
+
+void ResetTaskStatistics()
+{
+	for (int i=0;i<TASK_COUNT;i++) {
+		statistics[i].runs = 0U;
+		statistics[i].deferrals = 0U;
+		statistics[i].overruns = 0U;
+		statistics[i].maximum_cycles = 0U;
+		statistics[i].total_cycles = 0U;
+	}
+}
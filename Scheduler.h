@@ -0,0 +1,83 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Cooperative main loop scheduler
+//
+// Each main loop module is a task in a static table with a period and
+// phase (in milliseconds), a priority and a time budget.  Once per tick,
+// the scheduler runs the tasks that are due in priority order.  If the
+// time used so far in the tick plus a task's budget would take the loop
+// past TICK_BUDGET_US, a non-critical task is put off to the next tick
+// (but only once), so that the work is spread out and the worst case
+// loop time is flattened.  Phase offsets keep the slower tasks from
+// landing on the same tick.
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+
+typedef enum _Tasks
+{
+	TimersTask,
+	SwitchesTask,
+	GesturesTask,
+	AnalogueTask,
+	ApplicationTask,
+	PrintSupportTask,
+	DebugTask,
+	DebugScreenTask,
+	UsageTask,
+	StoreTask,
+	LastTaskIndex = StoreTask
+} TaskName;
+
+#define TASK_COUNT (((int) LastTaskIndex)+1)
+
+// Lower values run first; critical tasks are never put off
+typedef enum {
+	CriticalPriority,
+	HighPriority,
+	NormalPriority,
+	LowPriority
+} TaskPriority;
+
+typedef struct {
+	uint32_t runs;
+	uint32_t deferrals;       // Times put off to the next tick
+	uint32_t overruns;        // Runs that took longer than the budget
+	uint32_t maximum_cycles;
+	uint64_t total_cycles;
+} TaskStatistics;
+
+void InitScheduler();
+// Called once per main loop iteration
+void RunScheduler();
+
+// Milliseconds (at most limit) until a task with a period of more than
+// one tick is next due (for tickless idle: the tasks that run every tick
+// are run whenever the loop wakes)
+uint32_t GetTimeToNextTask(uint32_t limit);
+
+const TaskStatistics *GetTaskStatistics(TaskName task);
+const char *GetTaskName(TaskName task);
+uint32_t GetTaskPeriod(TaskName task);
+uint32_t GetTaskBudget(TaskName task);
+void ResetTaskStatistics();
+
+#endif
@@ -0,0 +1,220 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Run-time adjustable settings
+
+#include "Global.h"
+#include "Settings.h"
+#include "Store.h"
+
+#include <assert.h>
+#include <string.h>
+
+// List of supported settings
+static const struct {
+	SettingName name;
+	SettingType type;
+	uint32_t minimum;
+	uint32_t maximum;
+	uint32_t default_value;
+	const char *displayname;
+} SettingList[SETTING_COUNT] = {
+	// Current thresholds are in ADC units (about 24 mA per LSB)
+	{CurrentHysteresisHighSetting, SettingTypeUInt16, 1U,   2047U,  70U,   "hysteresis_high"},
+	{CurrentHysteresisLowSetting,  SettingTypeUInt16, 0U,   2046U,  50U,   "hysteresis_low"},
+	// ADC reading with no current flowing
+	{CurrentZeroOffsetSetting,     SettingTypeUInt16, 0U,   4095U,  2047U, "zero_offset"},
+	// Times in milliseconds
+	{RunOnDelaySetting,            SettingTypeUInt32, 0U,   60000U, 2000U, "run_on_ms"},
+	{TurnOffDurationSetting,       SettingTypeUInt32, 100U, 60000U, 2000U, "turn_off_ms"},
+	{StartupIgnoreSetting,         SettingTypeUInt32, 0U,   10000U, 1000U, "startup_ignore_ms"},
+	{DiagnosticHoldSetting,        SettingTypeUInt32, 500U, 60000U, 2000U, "diagnostic_hold_ms"},
+	// Limited by the size of the debounce counter
+	{DebounceSetting,              SettingTypeUInt8,  1U,   250U,   100U,  "debounce_ms"},
+	// Turn on from the shape of the raw samples (see StartDetector.h):
+	// rise in ADC units over START_WINDOW samples and how long the
+	// average has to confirm it before the turn-on is withdrawn
+	{PredictiveStartSetting,       SettingTypeBool,   0U,   1U,     1U,    "predictive_start"},
+	{StartSlopeSetting,            SettingTypeUInt16, 1U,   2047U,  40U,   "start_slope"},
+	{StartConfirmSetting,          SettingTypeUInt32, 64U,  2000U,  250U,  "start_confirm_ms"},
+	// Run-on time from how long and how hard the tool ran (see
+	// RunOnPolicy.h); run_on_ms is used instead if this is off
+	{AdaptiveRunOnSetting,         SettingTypeBool,   0U,   1U,     1U,    "adaptive_run_on"},
+	{RunOnMinimumSetting,          SettingTypeUInt32, 0U,   60000U, 500U,  "run_on_min_ms"},
+	{RunOnMaximumSetting,          SettingTypeUInt32, 0U,   60000U, 10000U, "run_on_max_ms"},
+	// Milliseconds per second of tool running time
+	{RunOnPerSecondSetting,        SettingTypeUInt32, 0U,   10000U, 50U,   "run_on_per_s"},
+	// Milliseconds per 100 ADC unit seconds (about 2.4 A s) of charge
+	{RunOnPerChargeSetting,        SettingTypeUInt32, 0U,   10000U, 20U,   "run_on_per_charge"},
+	// mA per ADC unit in Q16 (0.1 to 100 mA), normally set with the
+	// "calibrate" command
+	{CurrentGainSetting,             SettingTypeUInt32, 6554U, 6553600U, 1572864U, "current_gain_q16"},
+	// If set, the thresholds are taken from the _ma settings below
+	// (converted with the gain) rather than from the ADC unit ones
+	{MilliampThresholdsSetting,      SettingTypeBool,   0U,    1U,       0U,       "thresholds_in_ma"},
+	{HysteresisHighMilliampsSetting, SettingTypeUInt32, 1U,    100000U,  1680U,    "hysteresis_high_ma"},
+	{HysteresisLowMilliampsSetting,  SettingTypeUInt32, 0U,    99999U,   1200U,    "hysteresis_low_ma"},
+	// ADC samples taken within this many microseconds of a transmit
+	// edge are replaced by the previous sample, up to three in a row
+	// (0 to disable)
+	{AdcGuardSetting,                SettingTypeUInt16, 0U,    200U,     20U,      "adc_guard_us"},
+};
+
+static uint32_t values[SETTING_COUNT];
+
+static uint16_t StoreKey(SettingName name)
+{
+	return (uint16_t) (STORE_SETTINGS_FIRST_KEY + (uint16_t) name);
+}
+
+static bool ValueIsInRange(SettingName name, uint32_t value)
+{
+	return ((value >= SettingList[(int) name].minimum) && (value <= SettingList[(int) name].maximum));
+}
+
+// Check that a pair of thresholds isn't inverted
+static bool PairIsValid(SettingName name, uint32_t value, SettingName high, SettingName low)
+{
+	if ((name == low) && (value >= values[(int) high])) {
+		return false;
+	}
+	if ((name == high) && (value <= values[(int) low])) {
+		return false;
+	}
+	return true;
+}
+
+static bool ValueIsValid(SettingName name, uint32_t value)
+{
+	if ( ! ValueIsInRange(name, value)) {
+		return false;
+	}
+
+	// The hysteresis bands must not be inverted
+	return PairIsValid(name, value, CurrentHysteresisHighSetting, CurrentHysteresisLowSetting)
+		&& PairIsValid(name, value, HysteresisHighMilliampsSetting, HysteresisLowMilliampsSetting);
+}
+
+// Put an inverted pair back to the defaults
+static void CheckPair(SettingName high, SettingName low)
+{
+	if (values[(int) low] >= values[(int) high]) {
+		values[(int) low] = SettingList[(int) low].default_value;
+		values[(int) high] = SettingList[(int) high].default_value;
+	}
+}
+
+static void LoadSettings()
+{
+	int i;
+
+	// Each value is range-checked individually, so a value that has
+	// become invalid (e.g. due to a changed range) keeps its default.
+	for (i=0;i<SETTING_COUNT;i++) {
+		uint32_t value;
+		if (ReadStoreValue(StoreKey((SettingName) i), &value)
+				&& ValueIsInRange((SettingName) i, value)) {
+			values[i] = value;
+		}
+	}
+
+	CheckPair(CurrentHysteresisHighSetting, CurrentHysteresisLowSetting);
+	CheckPair(HysteresisHighMilliampsSetting, HysteresisLowMilliampsSetting);
+}
+
+void InitSettings()
+{
+	int i;
+
+	static_assert(SETTING_COUNT <= STORE_SETTINGS_KEY_COUNT, "Too many settings for the store");
+
+	for (i=0;i<SETTING_COUNT;i++) {
+		// Check that the settings are in the right order in the array
+		assert(SettingList[i].name == ((int) i));
+
+		values[i] = SettingList[i].default_value;
+	}
+
+	LoadSettings();
+}
+
+uint32_t GetSetting(SettingName name)
+{
+	return values[(int) name];
+}
+
+SettingResult SetSetting(SettingName name, uint32_t value)
+{
+	if ( ! ValueIsValid(name, value)) {
+		return SettingOutOfRange;
+	}
+	values[(int) name] = value;
+	return SettingOK;
+}
+
+// Queue any changed settings to be written to flash.  This returns
+// straight away: the store writes them over the next few ticks.
+SettingResult SaveSettings()
+{
+	bool ok = true;
+
+	for (int i=0;i<SETTING_COUNT;i++) {
+		if ( ! WriteStoreValue(StoreKey((SettingName) i), values[i])) {
+			ok = false;
+		}
+	}
+
+	if (ok) {
+		return SettingOK;
+	}
+	else {
+		return SettingFlashError;
+	}
+}
+
+bool FindSetting(const char *text, SettingName *name)
+{
+	for (int i=0;i<SETTING_COUNT;i++) {
+		if (strcmp(text, SettingList[i].displayname) == 0) {
+			*name = (SettingName) i;
+			return true;
+		}
+	}
+	return false;
+}
+
+const char *GetSettingName(SettingName name)
+{
+	return SettingList[(int) name].displayname;
+}
+
+SettingType GetSettingType(SettingName name)
+{
+	return SettingList[(int) name].type;
+}
+
+uint32_t GetSettingMinimum(SettingName name)
+{
+	return SettingList[(int) name].minimum;
+}
+
+uint32_t GetSettingMaximum(SettingName name)
+{
+	return SettingList[(int) name].maximum;
+}
@@ -0,0 +1,83 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Run-time adjustable settings
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+#include <stdint.h>
+
+// The position in this list is the key in the store (see Store.h), so
+// new settings go at the end.
+typedef enum _Settings
+{
+	CurrentHysteresisHighSetting,
+	CurrentHysteresisLowSetting,
+	CurrentZeroOffsetSetting,
+	RunOnDelaySetting,
+	TurnOffDurationSetting,
+	StartupIgnoreSetting,
+	DiagnosticHoldSetting,
+	DebounceSetting,
+	PredictiveStartSetting,
+	StartSlopeSetting,
+	StartConfirmSetting,
+	AdaptiveRunOnSetting,
+	RunOnMinimumSetting,
+	RunOnMaximumSetting,
+	RunOnPerSecondSetting,
+	RunOnPerChargeSetting,
+	CurrentGainSetting,
+	MilliampThresholdsSetting,
+	HysteresisHighMilliampsSetting,
+	HysteresisLowMilliampsSetting,
+	AdcGuardSetting,
+	LastSettingIndex = AdcGuardSetting
+} SettingName;
+
+#define SETTING_COUNT (((int) LastSettingIndex)+1)
+
+typedef enum {
+	SettingTypeBool,
+	SettingTypeUInt8,
+	SettingTypeUInt16,
+	SettingTypeUInt32
+} SettingType;
+
+typedef enum {
+	SettingOK,
+	SettingOutOfRange,
+	SettingFlashError
+} SettingResult;
+
+void InitSettings();
+
+uint32_t GetSetting(SettingName name);
+SettingResult SetSetting(SettingName name, uint32_t value);
+SettingResult SaveSettings();
+
+// Functions for the command shell
+bool FindSetting(const char *text, SettingName *name);
+const char *GetSettingName(SettingName name);
+SettingType GetSettingType(SettingName name);
+uint32_t GetSettingMinimum(SettingName name);
+uint32_t GetSettingMaximum(SettingName name);
+
+#endif
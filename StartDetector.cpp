@@ -0,0 +1,76 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Motor start detection
+
+#include "Global.h"
+#include "StartDetector.h"
+
+void StartDetector::Init(const StartDetectorParameters *parameters)
+{
+	this->parameters = parameters;
+	for (int i=0;i<(2 * START_WINDOW);i++) {
+		this->history[i] = 0U;
+	}
+	this->index = 0U;
+	this->count = 0U;
+	this->recent_sum = 0U;
+	this->previous_sum = 0U;
+	this->armed = true;
+}
+
+bool StartDetector::AddSample(uint16_t current)
+{
+	// history is a ring of the last 2 * START_WINDOW samples: the sample
+	// at index (the oldest) drops out of the previous window and the one
+	// START_WINDOW later moves from the recent window to the previous one
+	uint8_t middle = (uint8_t) ((this->index + START_WINDOW) & ((2 * START_WINDOW) - 1));
+	this->previous_sum += this->history[middle];
+	this->previous_sum -= this->history[this->index];
+	this->recent_sum -= this->history[middle];
+	this->recent_sum += current;
+	this->history[this->index] = current;
+	this->index = (uint8_t) ((this->index + 1U) & ((2 * START_WINDOW) - 1));
+
+	if (this->count < (2 * START_WINDOW)) {
+		this->count++;
+		return false;
+	}
+
+	uint32_t recent = this->recent_sum >> START_WINDOW_SHIFT;
+	uint32_t previous = this->previous_sum >> START_WINDOW_SHIFT;
+
+	if ( ! this->armed) {
+		if (recent < this->parameters->rearm_threshold) {
+			this->armed = true;
+		}
+		return false;
+	}
+
+	if (recent < (previous + this->parameters->slope_threshold)) {
+		return false;
+	}
+	for (int i=1;i<=START_WINDOW;i++) {
+		uint8_t sample = (uint8_t) ((this->index - i) & ((2 * START_WINDOW) - 1));
+		if (this->history[sample] <= this->parameters->level_threshold) {
+			return false;
+		}
+	}
+	this->armed = false;
+	return true;
+}
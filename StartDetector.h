@@ -0,0 +1,66 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Motor start detection
+//
+// Spots a power tool starting from the shape of the raw current samples
+// rather than waiting for the 64 sample average to cross the threshold.
+// A motor start draws an inrush current that rises within a couple of
+// milliseconds, so a start is recognised when each of the last
+// START_WINDOW samples is above the level threshold (so that a short
+// spike is ignored) and their average has risen by at least the slope
+// threshold since the START_WINDOW samples before that.
+// The detector then waits for the current to drop below the re-arm
+// threshold before it will recognise another start.
+
+#ifndef STARTDETECTOR_H
+#define STARTDETECTOR_H
+
+#include <stdint.h>
+
+// Samples in each of the two windows that are compared (a power of two)
+#define START_WINDOW_SHIFT 2
+#define START_WINDOW (1 << START_WINDOW_SHIFT)
+
+typedef struct {
+	uint16_t level_threshold; // Sample level that counts as running
+	uint16_t slope_threshold; // Minimum rise between the two windows
+	uint16_t rearm_threshold; // Window average that counts as stopped
+} StartDetectorParameters;
+
+class StartDetector
+{
+	public:
+		// The parameters are read on every sample so can be changed
+		// while running
+		void Init(const StartDetectorParameters *parameters);
+		// Takes one current sample (in the same units as the thresholds);
+		// returns true on the sample on which a start is recognised
+		bool AddSample(uint16_t current);
+
+	private:
+		const StartDetectorParameters *parameters;
+		uint16_t history[2 * START_WINDOW];
+		uint8_t index;
+		uint8_t count;
+		uint32_t recent_sum;   // Sum of the newest START_WINDOW samples
+		uint32_t previous_sum; // Sum of the START_WINDOW samples before those
+		bool armed;
+};
+
+#endif
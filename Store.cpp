@@ -0,0 +1,331 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Wear-levelled persistent store for 32-bit values
+
+#include "Global.h"
+#include "Store.h"
+#include "Flash.h"
+#include "Crc.h"
+#include "Application.h"
+#include "PrintSupport.h"
+
+// Change this if the layout of the store changes so that old data is
+// erased rather than misinterpreted.
+#define STORE_MAGIC ((uint32_t) 0x4B565331U)
+
+// Each sector starts with a header (the generation and then the magic
+// number, which is written last so that a half-copied sector is never
+// used) followed by the records.  Each record is a tag (the key in the
+// upper half and a check code in the lower half) and the value.  The
+// value is written first, so a record with a valid tag is complete.
+#define HEADER_MAGIC_OFFSET ((uint32_t) 0U)
+#define HEADER_GENERATION_OFFSET ((uint32_t) 4U)
+#define RECORDS_OFFSET ((uint32_t) 8U)
+#define RECORD_TAG_OFFSET ((uint32_t) 0U)
+#define RECORD_VALUE_OFFSET ((uint32_t) 4U)
+#define RECORD_SIZE ((uint32_t) 8U)
+#define RECORDS_PER_SECTOR ((uint16_t) ((FLASH_SECTOR_SIZE - RECORDS_OFFSET) / RECORD_SIZE))
+
+static const struct {
+	uint8_t sector;
+	uint32_t address;
+} SectorList[2] = {
+	{STORE_FLASH_SECTOR_A, STORE_FLASH_ADDRESS_A},
+	{STORE_FLASH_SECTOR_B, STORE_FLASH_ADDRESS_B},
+};
+
+// RAM copy of the latest value of each key
+static uint32_t values[STORE_KEY_COUNT];
+static bool value_present[STORE_KEY_COUNT];
+// Changed since last written to flash
+static bool value_dirty[STORE_KEY_COUNT];
+static uint16_t dirty_count;
+static uint16_t dirty_cursor;
+
+static bool available = false;
+static uint8_t active;       // Index into SectorList
+static uint16_t next_record; // Next free record in the active sector
+static bool spare_erased;
+
+// Copying the values into the spare sector
+static bool compacting = false;
+static uint16_t compact_key;
+static uint16_t compact_record;
+
+static StoreStatistics statistics;
+
+static uint8_t Spare()
+{
+	return (uint8_t) (1U - active);
+}
+
+static uint32_t RecordAddress(uint8_t sector_index, uint16_t record)
+{
+	return SectorList[sector_index].address + RECORDS_OFFSET + ((uint32_t) record * RECORD_SIZE);
+}
+
+static uint32_t RecordTag(uint16_t key, uint32_t value)
+{
+	uint32_t crc = UpdateCrc32(UpdateCrc32(CRC32_INITIAL, (uint32_t) key), value);
+	return (((uint32_t) key) << 16) | (crc & 0xFFFFU);
+}
+
+static bool ProgramRecord(uint8_t sector_index, uint16_t record, uint16_t key, uint32_t value)
+{
+	uint32_t address = RecordAddress(sector_index, record);
+	return ProgramFlashWord(address + RECORD_VALUE_OFFSET, value)
+		&& ProgramFlashWord(address + RECORD_TAG_OFFSET, RecordTag(key, value));
+}
+
+static bool SectorIsValid(uint8_t sector_index, uint32_t *generation)
+{
+	uint32_t address = SectorList[sector_index].address;
+	*generation = ReadFlashWord(address + HEADER_GENERATION_OFFSET);
+	return (ReadFlashWord(address + HEADER_MAGIC_OFFSET) == STORE_MAGIC);
+}
+
+static bool SectorIsBlank(uint8_t sector_index)
+{
+	uint32_t address = SectorList[sector_index].address;
+	for (uint32_t offset=0U;offset<FLASH_SECTOR_SIZE;offset+=4U) {
+		if (ReadFlashWord(address + offset) != FLASH_ERASED_WORD) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool EraseSector(uint8_t sector_index)
+{
+	statistics.erases++;
+	return EraseFlashSector(SectorList[sector_index].sector) && SectorIsBlank(sector_index);
+}
+
+static bool WriteHeader(uint8_t sector_index, uint32_t generation)
+{
+	uint32_t address = SectorList[sector_index].address;
+	return ProgramFlashWord(address + HEADER_GENERATION_OFFSET, generation)
+		&& ProgramFlashWord(address + HEADER_MAGIC_OFFSET, STORE_MAGIC);
+}
+
+// Build the RAM copy from the records in the active sector and find
+// the end of the log
+static void ScanActiveSector()
+{
+	next_record = RECORDS_PER_SECTOR;
+	for (uint16_t record=0U;record<RECORDS_PER_SECTOR;record++) {
+		uint32_t address = RecordAddress(active, record);
+		uint32_t tag = ReadFlashWord(address + RECORD_TAG_OFFSET);
+		uint32_t value = ReadFlashWord(address + RECORD_VALUE_OFFSET);
+
+		if (tag == FLASH_ERASED_WORD) {
+			if (value == FLASH_ERASED_WORD) {
+				next_record = record;
+				break;
+			}
+			// Interrupted after the value was written: skip it
+			continue;
+		}
+
+		uint16_t key = (uint16_t) (tag >> 16);
+		if ((key < STORE_KEY_COUNT) && (tag == RecordTag(key, value))) {
+			values[key] = value;
+			value_present[key] = true;
+		}
+	}
+}
+
+void InitStore()
+{
+	uint32_t generation[2];
+	bool valid[2];
+
+	for (uint16_t key=0U;key<STORE_KEY_COUNT;key++) {
+		value_present[key] = false;
+		value_dirty[key] = false;
+	}
+	dirty_count = 0U;
+	dirty_cursor = 0U;
+	compacting = false;
+
+	valid[0] = SectorIsValid(0U, &generation[0]);
+	valid[1] = SectorIsValid(1U, &generation[1]);
+
+	if (valid[0] && valid[1]) {
+		// Reset after a compaction but before the old sector was
+		// erased: the newer one is active
+		active = (((int32_t) (generation[1] - generation[0])) > 0) ? 1U : 0U;
+	}
+	else if (valid[0] || valid[1]) {
+		active = valid[0] ? 0U : 1U;
+	}
+	else {
+		// Never used (or an old layout): start again.  This is the
+		// only erase done outside the idle time.
+		active = 0U;
+		generation[0] = 1U;
+		available = (SectorIsBlank(0U) || EraseSector(0U)) && WriteHeader(0U, generation[0]);
+		if ( ! available) {
+			return;
+		}
+	}
+
+	available = true;
+	statistics.generation = generation[active];
+	ScanActiveSector();
+	spare_erased = SectorIsBlank(Spare());
+}
+
+static void StartCompaction()
+{
+	compacting = true;
+	compact_key = 0U;
+	compact_record = 0U;
+}
+
+// Copy one value into the spare sector (or finish the copy)
+static void UpdateCompaction()
+{
+	while ((compact_key < STORE_KEY_COUNT) && ( ! value_present[compact_key])) {
+		compact_key++;
+	}
+
+	if (compact_record >= RECORDS_PER_SECTOR) {
+		// Too many write errors: try again with a freshly erased sector
+		compacting = false;
+		spare_erased = false;
+		return;
+	}
+
+	if (compact_key < STORE_KEY_COUNT) {
+		if (ProgramRecord(Spare(), compact_record, compact_key, values[compact_key])) {
+			if (value_dirty[compact_key]) {
+				value_dirty[compact_key] = false;
+				dirty_count--;
+			}
+			compact_key++;
+		}
+		else {
+			statistics.write_errors++;
+		}
+		compact_record++;
+		return;
+	}
+
+	if ( ! WriteHeader(Spare(), statistics.generation + 1U)) {
+		statistics.write_errors++;
+		compacting = false;
+		spare_erased = false;
+		return;
+	}
+
+	statistics.generation++;
+	statistics.compactions++;
+	active = Spare();
+	next_record = compact_record;
+	spare_erased = false;
+	compacting = false;
+}
+
+// Append the next changed value to the log
+static void WriteNextValue()
+{
+	while ( ! value_dirty[dirty_cursor]) {
+		dirty_cursor = (uint16_t) ((dirty_cursor + 1U) % STORE_KEY_COUNT);
+	}
+
+	uint16_t key = dirty_cursor;
+	if (ProgramRecord(active, next_record, key, values[key])) {
+		value_dirty[key] = false;
+		dirty_count--;
+		statistics.writes++;
+	}
+	else {
+		// The record can't be reused; try again in the next one
+		statistics.write_errors++;
+	}
+	next_record++;
+}
+
+void UpdateStore()
+{
+	if ( ! available) {
+		return;
+	}
+
+	if (compacting) {
+		UpdateCompaction();
+	}
+	else if ((dirty_count > 0U) && (next_record < RECORDS_PER_SECTOR)) {
+		WriteNextValue();
+	}
+	else if ((dirty_count > 0U) && spare_erased) {
+		StartCompaction();
+	}
+	else if (( ! spare_erased) && IsApplicationIdle() && IsPrintSupportIdle()) {
+		// Get the spare sector ready ahead of time.  This stalls the
+		// main loop but the millisecond count and the UART keep going
+		// (see EraseFlashSector).
+		spare_erased = EraseSector(Spare());
+	}
+	else {
+		// Nothing to do
+	}
+}
+
+bool IsStoreIdle()
+{
+	return (dirty_count == 0U) && ( ! compacting);
+}
+
+bool ReadStoreValue(uint16_t key, uint32_t *value)
+{
+	if ((key >= STORE_KEY_COUNT) || ( ! value_present[key])) {
+		return false;
+	}
+	*value = values[key];
+	return true;
+}
+
+bool WriteStoreValue(uint16_t key, uint32_t value)
+{
+	if (( ! available) || (key >= STORE_KEY_COUNT)) {
+		return false;
+	}
+	if (value_present[key] && (values[key] == value)) {
+		return true;
+	}
+
+	values[key] = value;
+	value_present[key] = true;
+	if ( ! value_dirty[key]) {
+		value_dirty[key] = true;
+		dirty_count++;
+	}
+	return true;
+}
+
+const StoreStatistics *GetStoreStatistics()
+{
+	statistics.records_used = next_record;
+	statistics.records_total = RECORDS_PER_SECTOR;
+	statistics.pending = dirty_count;
+	return &statistics;
+}
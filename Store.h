@@ -0,0 +1,78 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Wear-levelled persistent store for 32-bit values
+//
+// Values are appended to a log in flash as records of a key, the value
+// and a check code, so changing a value never erases anything.  The
+// latest record for each key wins and the values are kept in RAM, so
+// reads don't touch flash.  Two sectors are used in turn: when the
+// active one is full, the current values are copied into the other
+// (which becomes active once a header is written at the end of the
+// copy) and the old one is erased later.
+//
+// Writes are queued and programmed by UpdateStore (one record per
+// tick), so they never hold up the main loop for long.  Erasing a
+// sector stalls the main loop, as the F411 has a single flash bank and
+// the loop runs from flash: 250 ms typically and 500 ms at worst for a
+// 16 kB sector (x32 parallelism, from the datasheet).  The tick and UART
+// interrupts carry on from RAM.  The erase can't be split up or run in
+// the background, so it's only started while the application and UART
+// are idle; a tool that starts just after that can still wait up to
+// 500 ms longer than usual for the output to turn on.
+//
+// A write that's interrupted by a reset leaves a record that fails its
+// check and is skipped, so the key keeps its previous value.
+
+#ifndef STORE_H
+#define STORE_H
+
+#include <stdint.h>
+
+// Keys are allocated in blocks to each user of the store
+#define STORE_SETTINGS_FIRST_KEY ((uint16_t) 0U)
+#define STORE_SETTINGS_KEY_COUNT ((uint16_t) 64U)
+#define STORE_USAGE_FIRST_KEY ((uint16_t) 64U)
+#define STORE_USAGE_KEY_COUNT ((uint16_t) 32U)
+#define STORE_KEY_COUNT ((uint16_t) 96U)
+
+typedef struct {
+	uint32_t generation;     // Incremented on each compaction
+	uint16_t records_used;   // In the active sector
+	uint16_t records_total;
+	uint16_t pending;        // Values waiting to be written
+	uint32_t writes;
+	uint32_t compactions;
+	uint32_t erases;
+	uint32_t write_errors;
+} StoreStatistics;
+
+void InitStore();
+void UpdateStore();
+bool IsStoreIdle();
+
+// False if the key has never been written
+bool ReadStoreValue(uint16_t key, uint32_t *value);
+// Queues the value to be written if it has changed; false if the store
+// isn't usable or the key is out of range
+bool WriteStoreValue(uint16_t key, uint32_t value);
+
+const StoreStatistics *GetStoreStatistics();
+
+#endif
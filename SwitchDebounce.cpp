@@ -22,37 +22,59 @@
 #include "cmsis.h"
 #include "SwitchDebounce.h"
 #include "Pins.h"
+#include "Timers.h"
+#include "Trace.h"
+#include "EdgeCapture.h"
 
 #define DEFAULT_STATE false
-#define DEBOUNCE_MS ((uint_fast8_t) 100)
+// Quiet time after the last edge before the input is read; longer than
+// the contact bounce but well under the polled debounce time
+#define EDGE_SETTLE_MS ((uint32_t) 5U)
 
-SwitchDebounce::SwitchDebounce(GPIO_TypeDef *port, uint8_t pin)
+bool SwitchDebounce::Init(GPIO_TypeDef *port, uint8_t pin, TimerName timer)
 {
 	this->sw_port = port;
 	this->sw_pin = pin;
+	this->settle_timer = timer;
 
 	SetPinAsInputFloat(port, pin);
-	this->last_state = GetPinState(port, pin);
 	this->initialised = false;
-	this->validated_state = ! this->last_state;
+	this->validated_state = DEFAULT_STATE;
+	this->settling = false;
+	this->first_edge_time = GetTimestamp();
+	this->change_time = this->first_edge_time;
+
+	if ( ! EnableEdgeCapture(port, pin)) {
+		return false;
+	}
+	// Read the initial state once it's had time to settle
+	StartTimer(timer, EDGE_SETTLE_MS);
+	return true;
+}
+
+void SwitchDebounce::HandleEdge(Timestamp time)
+{
+	if ( ! this->settling) {
+		this->settling = true;
+		this->first_edge_time = time;
+	}
+	StartTimer(this->settle_timer, EDGE_SETTLE_MS);
 }
 
 void SwitchDebounce::Update()
 {
+	// Nothing to do until the edges have stopped for EDGE_SETTLE_MS
+	if ( ! TimerHasExpired(this->settle_timer)) {
+		return;
+	}
 	bool current_state = GetPinState(this->sw_port, this->sw_pin);
 	if ((current_state != this->validated_state) || ( ! this->initialised)) {
-		if (current_state != this->last_state) {
-			this->counter = 0;
-			this->last_state = current_state;
-		}
-		else if (this->counter >= DEBOUNCE_MS) {
-			this->validated_state = current_state;
-			this->initialised = true;
-		}
-		else {
-			this->counter++;
-		}
+		TRACE(TraceButtonEdge, (((uint32_t) this->sw_pin) << 1) | (current_state ? 1U : 0U));
+		this->validated_state = current_state;
+		this->change_time = this->first_edge_time;
+		this->initialised = true;
 	}
+	this->settling = false;
 }
 
 bool SwitchDebounce::GetState()
@@ -69,3 +91,8 @@ bool SwitchDebounce::IsInitialised()
 {
 	return this->initialised;
 }
+
+Timestamp SwitchDebounce::GetChangeTime()
+{
+	return this->change_time;
+}
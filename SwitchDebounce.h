@@ -22,23 +22,39 @@
 #define SWITCHDEBOUNCE_H
 
 #include "cmsis.h"
+#include "Clock.h"
+#include "Timers.h"
 
+// Debouncer for an edge interrupt input (see EdgeCapture.h).  The input
+// is only read once it's been quiet for EDGE_SETTLE_MS after the last
+// edge, so a clean press is accepted within a few milliseconds.  Polled
+// inputs are debounced a whole port at a time in Switches.cpp.
 class SwitchDebounce
 {
 	public:
-		SwitchDebounce(GPIO_TypeDef *port, uint8_t pin);
+		// Returns false if the pin's EXTI line is in use by another port
+		// (in which case the input has to be polled instead)
+		bool Init(GPIO_TypeDef *port, uint8_t pin, TimerName timer);
 		void Update();
+		// Called for each edge on this pin
+		void HandleEdge(Timestamp time);
 		bool GetState();
 		bool IsInitialised();
+		// Time at which the input first moved towards its current state
+		Timestamp GetChangeTime();
 
 	private:
 		GPIO_TypeDef *sw_port;
 		uint8_t sw_pin;
 
-		bool last_state;
 		bool validated_state;
 		bool initialised;
-		uint_fast8_t counter;
+		// Runs while waiting for the input to settle
+		TimerName settle_timer;
+		// First edge since the input was last stable
+		bool settling;
+		Timestamp first_edge_time;
+		Timestamp change_time;
 };
 
 #endif
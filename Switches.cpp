@@ -23,6 +23,10 @@
 
 #include "SwitchDebounce.h"
 #include "Switches.h"
+#include "Timers.h"
+#include "EdgeCapture.h"
+#include "Settings.h"
+#include "Trace.h"
 
 #include "Pins.h"
 #include "DefinedPins.h"
@@ -36,27 +40,160 @@
 static const char *ON_STRING = "on";
 static const char *OFF_STRING = "off";
 
+// Build with -D POLLED_SWITCHES to debounce every switch by polling its
+// port instead of using edge interrupts (e.g. if the EXTI lines are
+// needed for something else)
+#ifdef POLLED_SWITCHES
+#define EDGE_INTERRUPT false
+#else
+#define EDGE_INTERRUPT true
+#endif
+
 // List of supported switches
 static const struct {
 	SwitchName name;
 	GPIO_TypeDef *port;
 	uint8_t pin;
-	bool momentary;
 	bool false_is_pressed;
+	bool edge_interrupt; // Use EXTI edge capture rather than polling
+	TimerName debounce_timer; // Only used with edge_interrupt
 	const char *displayname;
 } SwitchList[SWITCH_COUNT] = {
-	{PushButtonSwitch,  PUSH_BUTTON_PIN,    true,  true, "Push Button"},
+	{PushButtonSwitch,  PUSH_BUTTON_PIN,    true, EDGE_INTERRUPT, PushButtonDebounceTimer, "Push Button"},
 };
 
-// States of each switch
-static enum {
-	SwitchOff = 0,
-	SwitchHeld,
-	SwitchReleased
-} momentary_states[SWITCH_COUNT];
+// Edge interrupt debouncers (only used if uses_interrupt is set)
+static SwitchDebounce debouncers[SWITCH_COUNT];
+static bool uses_interrupt[SWITCH_COUNT];
+
+static uint32_t last_edge_overflow_count = 0U;
+
+/*
+ * Polled switches are debounced a port at a time: the whole IDR is read
+ * once per sample and each pin has a two bit vertical counter (bit 0 of
+ * every pin's count in count0 and bit 1 in count1), so all 16 pins are
+ * updated with a handful of bitwise operations.  A pin's counter runs
+ * while its sample differs from the debounced state and is cleared when
+ * it matches; after four differing samples in a row the debounced state
+ * changes.  The sample period is a quarter of the debounce setting so
+ * that a change is accepted after roughly DEBOUNCE_MS.
+ */
+#define DEBOUNCE_MS GetSetting(DebounceSetting)
+#define VERTICAL_COUNT 4U
+
+// One per GPIO port (A-E and H)
+#define MAX_SWITCH_PORTS 6
+
+static struct {
+	GPIO_TypeDef *port;
+	uint16_t mask;     // Polled switch pins on this port
+	uint16_t state;    // Debounced levels
+	uint16_t count0;   // Vertical counter (low bit)
+	uint16_t count1;   // Vertical counter (high bit)
+} port_groups[MAX_SWITCH_PORTS];
+static int port_group_count = 0;
+
+// Port group for each polled switch and the time its last accepted
+// change started
+static uint8_t switch_groups[SWITCH_COUNT];
+static Timestamp polled_change_times[SWITCH_COUNT];
+static Timestamp polled_first_change_times[SWITCH_COUNT];
+
+static uint8_t GetPortGroup(GPIO_TypeDef *port)
+{
+	int i;
+	for (i=0;i<port_group_count;i++) {
+		if (port_groups[i].port == port) {
+			return (uint8_t) i;
+		}
+	}
+	assert(port_group_count < MAX_SWITCH_PORTS);
+	port_groups[i].port = port;
+	port_groups[i].mask = 0U;
+	port_groups[i].state = 0U;
+	port_groups[i].count0 = 0U;
+	port_groups[i].count1 = 0U;
+	port_group_count++;
+	return (uint8_t) i;
+}
+
+static uint32_t GetSamplePeriod()
+{
+	uint32_t period = DEBOUNCE_MS / VERTICAL_COUNT;
+	return (period > 0U) ? period : 1U;
+}
+
+// Record the start and end of changes (rare, so done a pin at a time)
+static void RecordPolledChanges(uint8_t group, uint16_t started, uint16_t accepted)
+{
+	Timestamp now = GetTimestamp();
+	for (int i=0;i<SWITCH_COUNT;i++) {
+		if (uses_interrupt[i] || (switch_groups[i] != group)) {
+			continue;
+		}
+		uint16_t mask = (uint16_t) (1U << SwitchList[i].pin);
+		// The debounced level (after any change has been accepted)
+		uint32_t level = ((port_groups[group].state & mask) != 0U) ? 1U : 0U;
+		(void) level;
+		if (started & mask) {
+			TRACE(TraceButtonRawEdge, (((uint32_t) SwitchList[i].pin) << 1) | (level ^ 1U));
+			polled_first_change_times[i] = now;
+		}
+		if (accepted & mask) {
+			TRACE(TraceButtonEdge, (((uint32_t) SwitchList[i].pin) << 1) | level);
+			polled_change_times[i] = polled_first_change_times[i];
+		}
+	}
+}
+
+static void UpdatePolledSwitches()
+{
+	if ( ! TimerHasExpired(SwitchSampleTimer)) {
+		return;
+	}
+	StartTimer(SwitchSampleTimer, GetSamplePeriod());
+
+	for (int g=0;g<port_group_count;g++) {
+		uint16_t sample = (uint16_t) (port_groups[g].port->IDR & port_groups[g].mask);
+		uint16_t delta = sample ^ port_groups[g].state;
+		uint16_t running = port_groups[g].count0 | port_groups[g].count1;
+
+		port_groups[g].count1 = (port_groups[g].count1 ^ port_groups[g].count0) & delta;
+		port_groups[g].count0 = (uint16_t) (~port_groups[g].count0) & delta;
+		// Pins whose counter has wrapped round to zero while still different
+		uint16_t accepted = delta & (uint16_t) ~(port_groups[g].count0 | port_groups[g].count1);
+		port_groups[g].state ^= accepted;
+
+		uint16_t started = delta & (uint16_t) ~running;
+		if ((started | accepted) != 0U) {
+			RecordPolledChanges((uint8_t) g, started & (uint16_t) ~accepted, accepted);
+		}
+	}
+}
+
+// Pass the captured edges to the debouncers for their pins
+static void DispatchEdges()
+{
+	Edge edge;
+	while (GetNextEdge(&edge)) {
+		for (int i=0;i<SWITCH_COUNT;i++) {
+			if (uses_interrupt[i] && (SwitchList[i].pin == edge.pin)) {
+				debouncers[i].HandleEdge(edge.time);
+			}
+		}
+	}
 
-// Debouncer implementations for each switch (instantiated in InitSwitches)
-static SwitchDebounce *debouncers[SWITCH_COUNT];
+	// If edges were lost, any of the inputs may have changed
+	uint32_t overflow_count = GetEdgeOverflowCount();
+	if (overflow_count != last_edge_overflow_count) {
+		last_edge_overflow_count = overflow_count;
+		for (int i=0;i<SWITCH_COUNT;i++) {
+			if (uses_interrupt[i]) {
+				debouncers[i].HandleEdge(GetTimestamp());
+			}
+		}
+	}
+}
 
 void InitSwitches()
 {
@@ -65,43 +202,67 @@ void InitSwitches()
 		// Check that the switches are in the right order in the array
 		assert(SwitchList[i].name == ((int) i));
 
-		debouncers[i] = new SwitchDebounce(SwitchList[i].port, SwitchList[i].pin);
-		momentary_states[i] = SwitchOff;
+		uses_interrupt[i] = SwitchList[i].edge_interrupt
+			&& debouncers[i].Init(SwitchList[i].port, SwitchList[i].pin,
+					SwitchList[i].debounce_timer);
+		if ( ! uses_interrupt[i]) {
+			// Falls back to polling if the EXTI line is taken
+			SetPinAsInputFloat(SwitchList[i].port, SwitchList[i].pin);
+			uint8_t group = GetPortGroup(SwitchList[i].port);
+			switch_groups[i] = group;
+			port_groups[group].mask |= (uint16_t) (1U << SwitchList[i].pin);
+			polled_change_times[i] = GetTimestamp();
+			polled_first_change_times[i] = polled_change_times[i];
+		}
+	}
+
+	// Start from the current levels
+	for (i=0;i<port_group_count;i++) {
+		port_groups[i].state = (uint16_t) (port_groups[i].port->IDR & port_groups[i].mask);
+	}
+	if (port_group_count > 0) {
+		StartTimer(SwitchSampleTimer, GetSamplePeriod());
 	}
 }
 
+// Debounced level of the input (before false_is_pressed)
+static bool GetDebouncedLevel(int index)
+{
+	if (uses_interrupt[index]) {
+		return debouncers[index].GetState();
+	}
+	return (port_groups[switch_groups[index]].state & (1U << SwitchList[index].pin)) != 0U;
+}
+
 void UpdateSwitches()
 {
-	// Update each debouncer and handle momentary switch monitoring
+	DispatchEdges();
+	UpdatePolledSwitches();
+
 	for (int i=0;i<SWITCH_COUNT;i++) {
-		debouncers[i]->Update();
-		if (SwitchList[i].momentary) {
-			bool switch_state = debouncers[i]->GetState();
-			if (SwitchList[i].false_is_pressed) {
-				switch_state = ! switch_state;
-			}
-			if ((momentary_states[i] == SwitchOff) && switch_state) {
-				momentary_states[i] = SwitchHeld;
-			}
-			else if ((momentary_states[i] == SwitchHeld) && ( ! switch_state)) {
-				momentary_states[i] = SwitchReleased;
-			}
-			else {
-				// Do nothing
-			}
+		if (uses_interrupt[i]) {
+			debouncers[i].Update();
 		}
 	}
 }
 
 bool GetSwitchState(SwitchName name)
 {
-	bool switch_state = debouncers[(int) name]->GetState();
+	bool switch_state = GetDebouncedLevel((int) name);
 	if (SwitchList[(int) name].false_is_pressed) {
 		switch_state = ! switch_state;
 	}
 	return switch_state;
 }
 
+Timestamp GetSwitchChangeTime(SwitchName name)
+{
+	if (uses_interrupt[(int) name]) {
+		return debouncers[(int) name].GetChangeTime();
+	}
+	return polled_change_times[(int) name];
+}
+
 const char * GetSwitchStateString(SwitchName name)
 {
 	if (GetSwitchState(name)) {
@@ -112,17 +273,6 @@ const char * GetSwitchStateString(SwitchName name)
 	}
 }
 
-bool HasReceivedMomentaryButton(SwitchName name)
-{
-	if (SwitchList[(int) name].momentary) {
-		if (momentary_states[(int) name] == SwitchReleased) {
-			momentary_states[(int) name] = SwitchOff;
-			return true;
-		}
-	}
-	return false;
-}
-
 bool GetPushButtonState()
 {
 	return GetSwitchState(PushButtonSwitch);
@@ -21,6 +21,8 @@
 #ifndef SWITCHES_H
 #define SWITCHES_H
 
+#include "Clock.h"
+
 typedef enum _Switches
 {
 	PushButtonSwitch,
@@ -31,8 +33,10 @@ void InitSwitches();
 void UpdateSwitches();
 
 bool GetSwitchState(SwitchName name);
+// When the switch first started to move to its current state (the first
+// edge, so it doesn't include the debounce time)
+Timestamp GetSwitchChangeTime(SwitchName name);
 const char *GetSwitchStateString(SwitchName name);
-bool HasReceivedMomentaryButton(SwitchName name);
 
 // Debug functions
 bool GetPushButtonState();
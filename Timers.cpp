@@ -0,0 +1,273 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Software timer service
+
+#include "Global.h"
+#include "Clock.h"
+#include "Timers.h"
+
+#include <stddef.h> // NULL
+#include <assert.h>
+
+// Three levels of 64 slots: level 0 has 1 ms slots, level 1 has 64 ms
+// slots and level 2 has 4096 ms slots, covering 2^18 ms (over four
+// minutes).  Longer timers are parked in the furthest level 2 slot and
+// re-filed each time that slot comes round.
+#define SLOT_BITS 6
+#define SLOTS_PER_LEVEL (1U << SLOT_BITS)
+#define SLOT_MASK (SLOTS_PER_LEVEL - 1U)
+#define LEVEL_COUNT 3
+#define WHEEL_RANGE_MS ((uint32_t) 1U << (SLOT_BITS * LEVEL_COUNT))
+
+// Marks the end of a slot list
+#define NO_TIMER ((uint8_t) 0xFFU)
+
+// List of timers (in the same order as the enumeration) with optional
+// expiry callbacks
+static const struct {
+	TimerName name;
+	void (*callback)(TimerName name);
+	const char *displayname;
+} TimerList[TIMER_COUNT] = {
+	{StartupIgnoreTimer,      NULL, "StartupIgnore"},
+	{OutputRateTimer,         NULL, "OutputRate"},
+	{PushButtonDebounceTimer, NULL, "PushButtonDebounce"},
+	{PushButtonGestureTimer,  NULL, "PushButtonGesture"},
+	{SwitchSampleTimer,       NULL, "SwitchSample"},
+};
+
+static struct {
+	uint32_t expiry;   // Millisecond tick on which the timer expires
+	uint32_t period;   // Non-zero for periodic timers
+	uint8_t next;      // Links within the slot list
+	uint8_t previous;
+	uint8_t *head;     // Slot list containing the timer (NULL if stopped)
+	bool expired;
+} timers[TIMER_COUNT];
+
+static uint8_t wheel[LEVEL_COUNT][SLOTS_PER_LEVEL];
+
+// Last tick processed by UpdateTimers
+static uint32_t current_tick;
+static uint32_t running_count;
+
+static void Unlink(uint8_t index)
+{
+	uint8_t next = timers[index].next;
+	uint8_t previous = timers[index].previous;
+
+	if (previous == NO_TIMER) {
+		*timers[index].head = next;
+	}
+	else {
+		timers[previous].next = next;
+	}
+	if (next != NO_TIMER) {
+		timers[next].previous = previous;
+	}
+	timers[index].head = NULL;
+	running_count--;
+}
+
+// Put a timer into the slot for its expiry time: the lowest level that
+// can hold it, so that it's moved down a level (or expired) when the
+// wheel gets to that slot
+static void Insert(uint8_t index)
+{
+	uint32_t expiry = timers[index].expiry;
+	uint32_t delta = expiry - current_tick;
+	uint8_t *head;
+
+	if (delta >= WHEEL_RANGE_MS) {
+		// Too far away: re-file it when the last reachable slot comes round
+		expiry = current_tick + WHEEL_RANGE_MS - 1U;
+		delta = WHEEL_RANGE_MS - 1U;
+	}
+
+	if (delta < SLOTS_PER_LEVEL) {
+		head = &wheel[0][expiry & SLOT_MASK];
+	}
+	else if (delta < (SLOTS_PER_LEVEL * SLOTS_PER_LEVEL)) {
+		head = &wheel[1][(expiry >> SLOT_BITS) & SLOT_MASK];
+	}
+	else {
+		head = &wheel[2][(expiry >> (2 * SLOT_BITS)) & SLOT_MASK];
+	}
+
+	timers[index].head = head;
+	timers[index].previous = NO_TIMER;
+	timers[index].next = *head;
+	if (*head != NO_TIMER) {
+		timers[*head].previous = index;
+	}
+	*head = index;
+	running_count++;
+}
+
+// Move all of the timers in a higher level slot down the wheel
+static void Cascade(uint8_t level, uint32_t slot)
+{
+	uint8_t index = wheel[level][slot];
+
+	wheel[level][slot] = NO_TIMER;
+	while (index != NO_TIMER) {
+		uint8_t next = timers[index].next;
+		running_count--;
+		Insert(index);
+		index = next;
+	}
+}
+
+static void Expire(uint8_t index)
+{
+	Unlink(index);
+	timers[index].expired = true;
+	if (timers[index].period != 0U) {
+		timers[index].expiry += timers[index].period;
+		Insert(index);
+	}
+	if (TimerList[index].callback != NULL) {
+		TimerList[index].callback((TimerName) index);
+	}
+}
+
+void InitTimers()
+{
+	for (int i=0;i<TIMER_COUNT;i++) {
+		// Check that the timers are in the right order in the array
+		assert(TimerList[i].name == ((int) i));
+
+		timers[i].head = NULL;
+		timers[i].expired = false;
+	}
+	for (int level=0;level<LEVEL_COUNT;level++) {
+		for (uint32_t slot=0;slot<SLOTS_PER_LEVEL;slot++) {
+			wheel[level][slot] = NO_TIMER;
+		}
+	}
+	running_count = 0U;
+	current_tick = GetMillisecondCounter();
+}
+
+// Catch up with the millisecond tick (more than one step if the main
+// loop has overrun)
+void UpdateTimers()
+{
+	uint32_t now = GetMillisecondCounter();
+
+	while (current_tick != now) {
+		current_tick++;
+
+		// Move timers down from the higher levels when the lower level
+		// has gone all the way round (highest first, so that a timer can
+		// drop two levels at once)
+		if ((current_tick & SLOT_MASK) == 0U) {
+			if (((current_tick >> SLOT_BITS) & SLOT_MASK) == 0U) {
+				Cascade(2, (current_tick >> (2 * SLOT_BITS)) & SLOT_MASK);
+			}
+			Cascade(1, (current_tick >> SLOT_BITS) & SLOT_MASK);
+		}
+
+		uint8_t *head = &wheel[0][current_tick & SLOT_MASK];
+		while (*head != NO_TIMER) {
+			Expire(*head);
+		}
+	}
+}
+
+void StartTimer(TimerName name, uint32_t duration_ms)
+{
+	uint8_t index = (uint8_t) name;
+
+	if (timers[index].head != NULL) {
+		Unlink(index);
+	}
+	// Timing is from the current tick (which may be ahead of the last one
+	// processed); a zero duration expires on the next update
+	timers[index].expiry = GetMillisecondCounter() + duration_ms;
+	if (timers[index].expiry == current_tick) {
+		timers[index].expiry++;
+	}
+	timers[index].period = 0U;
+	timers[index].expired = false;
+	Insert(index);
+}
+
+void StartPeriodicTimer(TimerName name, uint32_t period_ms)
+{
+	if (period_ms == 0U) {
+		period_ms = 1U;
+	}
+	StartTimer(name, period_ms);
+	timers[(int) name].period = period_ms;
+}
+
+void StopTimer(TimerName name)
+{
+	uint8_t index = (uint8_t) name;
+
+	if (timers[index].head != NULL) {
+		Unlink(index);
+	}
+	timers[index].expired = false;
+}
+
+bool IsTimerRunning(TimerName name)
+{
+	return (timers[(int) name].head != NULL);
+}
+
+bool TimerHasExpired(TimerName name)
+{
+	bool expired = timers[(int) name].expired;
+	timers[(int) name].expired = false;
+	return expired;
+}
+
+uint32_t GetTimeToNextTimer(uint32_t limit)
+{
+	uint32_t behind = GetMillisecondCounter() - current_tick;
+	uint32_t delta;
+
+	// Only the lowest level is searched: anything in the higher levels
+	// can't expire before the lowest level has gone round
+	for (delta=1U;delta<=SLOTS_PER_LEVEL;delta++) {
+		uint32_t tick = current_tick + delta;
+		if ((wheel[0][tick & SLOT_MASK] != NO_TIMER) || ((tick & SLOT_MASK) == 0U)) {
+			break;
+		}
+	}
+
+	if (delta <= behind) {
+		// Already due
+		return 0U;
+	}
+	delta -= behind;
+	return (delta < limit) ? delta : limit;
+}
+
+const char *GetTimerName(TimerName name)
+{
+	return TimerList[(int) name].displayname;
+}
+
+uint32_t GetRunningTimerCount()
+{
+	return running_count;
+}
@@ -0,0 +1,69 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Software timer service
+//
+// A hierarchical timer wheel driven by the millisecond tick.  Starting
+// and stopping a timer is O(1) (each timer is a node in a doubly-linked
+// slot list) and the per-tick cost doesn't depend on how many timers are
+// running: the tick only looks at one slot of the lowest level, and every
+// 64 ticks the timers in one slot of the next level up are moved down.
+//
+// When a timer expires, its callback (if any) is run from UpdateTimers
+// (in the main loop, not the interrupt) and its expired flag is set so
+// that the owner can check it with TimerHasExpired.
+
+#ifndef TIMERS_H
+#define TIMERS_H
+
+#include <stdint.h>
+
+typedef enum _Timers
+{
+	StartupIgnoreTimer,
+	OutputRateTimer,
+	PushButtonDebounceTimer,
+	PushButtonGestureTimer,
+	SwitchSampleTimer,
+	LastTimerIndex = SwitchSampleTimer
+} TimerName;
+
+#define TIMER_COUNT (((int) LastTimerIndex)+1)
+
+void InitTimers();
+void UpdateTimers();
+
+// Start (or restart) a timer to expire after the given number of
+// milliseconds.  A periodic timer restarts itself each time it expires.
+void StartTimer(TimerName name, uint32_t duration_ms);
+void StartPeriodicTimer(TimerName name, uint32_t period_ms);
+void StopTimer(TimerName name);
+bool IsTimerRunning(TimerName name);
+// Returns true (once) if the timer has expired since it was started or
+// since the last call
+bool TimerHasExpired(TimerName name);
+
+// Milliseconds (at most limit) until the timer service next needs to
+// run; may be earlier than the next expiry (when the wheel needs to move
+// timers down a level)
+uint32_t GetTimeToNextTimer(uint32_t limit);
+
+const char *GetTimerName(TimerName name);
+uint32_t GetRunningTimerCount();
+
+#endif
@@ -0,0 +1,72 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Event trace buffer
+
+#include "Global.h"
+#include "Trace.h"
+
+#ifdef TRACING
+
+TraceRecord trace_buffer[TRACE_BUFFER_LENGTH];
+// Total number of records ever added (the ring index is the bottom bits)
+volatile uint32_t trace_head = 0U;
+volatile bool trace_enabled = false;
+
+void InitTrace()
+{
+	// Timestamps come from the DWT cycle counter
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+	ClearTrace();
+	trace_enabled = true;
+}
+
+void ClearTrace()
+{
+	trace_head = 0U;
+}
+
+// Tracing is paused while the buffer is being dumped so that the records
+// don't change underneath the dump
+void EnableTrace(bool enable)
+{
+	trace_enabled = enable;
+}
+
+// Number of valid records (limited by the buffer size)
+uint32_t GetTraceRecordCount()
+{
+	uint32_t head = trace_head;
+	if (head > TRACE_BUFFER_LENGTH) {
+		return TRACE_BUFFER_LENGTH;
+	}
+	return head;
+}
+
+// Index 0 is the oldest record still in the buffer
+const TraceRecord *GetTraceRecord(uint32_t index)
+{
+	uint32_t head = trace_head;
+	uint32_t first = head - GetTraceRecordCount();
+	return &trace_buffer[(first + index) & (TRACE_BUFFER_LENGTH - 1U)];
+}
+
+#endif
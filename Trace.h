@@ -0,0 +1,95 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Event trace buffer
+//
+// Build with -D TRACING to enable; otherwise the TRACE macro compiles to
+// nothing.  Events are stored as compact binary records in a ring buffer
+// (the oldest records are overwritten) and can be dumped over the UART
+// with the "trace" command and converted with trace2json.py.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// Don't reorder these: the IDs are used by trace2json.py
+typedef enum {
+	TraceApplicationState = 1, // arg: new state
+	TraceTransmitWord,         // arg: new transmit word
+	TraceFrameStart,           // arg: word being sent
+	TraceFrameEnd,             // arg: word that was sent
+	TraceTransmitterIsrEntry,
+	TraceTransmitterIsrExit,
+	TraceButtonRawEdge,        // arg: (pin << 1) | level
+	TraceButtonEdge,           // arg: (pin << 1) | debounced level
+	TraceAdcWindow             // arg: averaged ADC reading
+} TraceEventId;
+
+// Each record is 8 bytes: the DWT cycle counter and a word with the event
+// ID in the top 6 bits and a 26-bit argument
+typedef struct {
+	uint32_t timestamp;
+	uint32_t event;
+} TraceRecord;
+
+#define TRACE_ARG_BITS 26
+#define TRACE_ARG_MASK ((uint32_t) ((1UL << TRACE_ARG_BITS) - 1U))
+
+// Must be a power of two
+#define TRACE_BUFFER_LENGTH 512U
+
+#ifdef TRACING
+#include "cmsis.h"
+
+extern TraceRecord trace_buffer[TRACE_BUFFER_LENGTH];
+extern volatile uint32_t trace_head;
+extern volatile bool trace_enabled;
+
+void InitTrace();
+void ClearTrace();
+uint32_t GetTraceRecordCount();
+const TraceRecord *GetTraceRecord(uint32_t index);
+void EnableTrace(bool enable);
+
+// Can be called from any context: the slot is claimed with an exclusive
+// load/store so that an interrupt can't claim the same one.
+static inline void AddTraceEvent(TraceEventId id, uint32_t arg)
+{
+	uint32_t index;
+	uint32_t timestamp = DWT->CYCCNT;
+
+	if ( ! trace_enabled) {
+		return;
+	}
+	do {
+		index = __LDREXW(&trace_head);
+	} while (__STREXW(index + 1U, &trace_head) != 0U);
+
+	TraceRecord *record = &trace_buffer[index & (TRACE_BUFFER_LENGTH - 1U)];
+	record->timestamp = timestamp;
+	record->event = (((uint32_t) id) << TRACE_ARG_BITS) | (arg & TRACE_ARG_MASK);
+}
+
+#define TRACE(id, arg) AddTraceEvent(id, arg)
+#else
+#define TRACE(id, arg)
+#endif
+
+#endif
@@ -22,6 +22,8 @@
 #include "Clock.h"
 #include "Pins.h"
 #include "DefinedPins.h"
+#include "Profiler.h"
+#include "Trace.h"
 
 #include "Transmitter.h"
 
@@ -54,20 +56,22 @@ static uint16_t bit0_on_time = 0;
 static volatile uint32_t next_transmit_word = UINT32_MAX;
 static uint16_t transmit_value = 0; 
 static volatile int bit_number = 0;
+// Complete frames sent (wraps)
+static volatile uint32_t frame_count = 0U;
+// Bit periods left in the gap after the current frame (the output is
+// held low during the gap)
+static volatile int pause_counter = 0;
 
-static enum {
-	TRANSMIT_Disabled,
-	TRANSMIT_TurnOff,
-	TRANSMIT_TurnOn,
-	TRANSMIT_Value
-} transmit_state;
+static TransmitState transmit_state;
 
 extern "C" void TIM2_IRQHandler()
 {
 	// Interrupt handler for bit transmission complete: send the next bit
-	static int pause_counter = 0;
 	static uint32_t transmit_word = 0;
 
+	PROFILE_START(start_cycles);
+	TRACE(TraceTransmitterIsrEntry, 0U);
+
 	TTIMER->SR &= (uint16_t) (~TIM_SR_UIF);
 	if (pause_counter > 0) {
 		// Pause counter is used to insert a gap between each packet transmission.
@@ -75,8 +79,14 @@ extern "C" void TIM2_IRQHandler()
 		pause_counter -= 1;
 		COMPARE = 0;
 		transmit_word = next_transmit_word;
+		TRACE(TraceTransmitterIsrExit, 0U);
+		PROFILE_END(TransmitterIsrProfile, start_cycles);
 		return;
 	}
+
+	if (bit_number == 0) {
+		TRACE(TraceFrameStart, transmit_word);
+	}
 	// Extract the bit from the configured transmit word
 	uint32_t this_bit = ((transmit_word >> (pattern_length-(1+bit_number))) & 0x1U);
 
@@ -92,7 +102,12 @@ extern "C" void TIM2_IRQHandler()
 	if (bit_number >= pattern_length) {
 		pause_counter = pattern_length;
 		bit_number = 0;
+		frame_count++;
+		TRACE(TraceFrameEnd, transmit_word);
 	}
+
+	TRACE(TraceTransmitterIsrExit, 0U);
+	PROFILE_END(TransmitterIsrProfile, start_cycles);
 }
 
 void InitTransmitter()
@@ -156,11 +171,14 @@ void UpdateTransmitter()
 		TTIMER->CNT = 0;
 		COMPARE = 0;
 		// Clear the next transmit word to an invalid state
+		if (next_transmit_word != UINT32_MAX) {
+			TRACE(TraceTransmitWord, UINT32_MAX);
+		}
 		next_transmit_word = UINT32_MAX;
-		SetPinState(LED_PIN, false);
+		LedPin::Clear();
 	}
 	else {
-		SetPinState(LED_PIN, true);
+		LedPin::Set();
 
 		// Start with the base pattern and then use bitwise-or operations
 		// to merge the unit mask and the command (on/off) mask
@@ -181,6 +199,9 @@ void UpdateTransmitter()
 		}
 		// Data all prepared, so transfer into the variable that the interrupt
 		// will use
+		if (preparation != next_transmit_word) {
+			TRACE(TraceTransmitWord, preparation);
+		}
 		next_transmit_word = preparation;
 
 		// If the timer's not running, start it
@@ -230,6 +251,52 @@ uint8_t GetTransmitterState()
 	return (uint8_t) transmit_state;
 }
 
+uint32_t GetTransmittedFrameCount()
+{
+	return frame_count;
+}
+
+// The output goes high at the start of each bit period (when the
+// counter wraps) and low when the counter reaches COMPARE.  While
+// COMPARE is 0 (the gap between frames) the output stays low, so this
+// bit has no edges, and the next bit only has edges if it isn't in the
+// gap too.  The on time of the next bit isn't known yet, so both
+// possibilities are checked.
+bool IsNearTransmitEdge(uint16_t window_us, uint16_t guard_us)
+{
+	if ((TTIMER->CR1 & TIM_CR1_CEN) == 0) {
+		return false;
+	}
+
+	int32_t count = (int32_t) TTIMER->CNT;
+	int32_t start = count - (int32_t) guard_us;
+	int32_t end = count + (int32_t) window_us + (int32_t) guard_us;
+	// The counter wraps to 0 after reaching ARR
+	int32_t period = (int32_t) TTIMER->ARR + 1;
+	int32_t compare = (int32_t) COMPARE;
+	bool this_bit_sent = (compare > 0);
+	// The gap starts after the last bit of a frame
+	bool next_bit_sent = (pause_counter == 0);
+
+	const struct {
+		bool possible;
+		int32_t time;
+	} edges[] = {
+		{this_bit_sent, 0},
+		{this_bit_sent, compare},
+		{next_bit_sent, period},
+		{next_bit_sent, period + (int32_t) bit0_on_time},
+		{next_bit_sent, period + (int32_t) bit1_on_time},
+	};
+
+	for (unsigned int i=0;i<(sizeof(edges)/sizeof(edges[0]));i++) {
+		if (edges[i].possible && (edges[i].time >= start) && (edges[i].time <= end)) {
+			return true;
+		}
+	}
+	return false;
+}
+
 uint8_t IsTransmitting()
 {
 	if (transmit_state == TRANSMIT_Disabled) {
@@ -21,6 +21,15 @@
 #ifndef TRANSMITTER_H
 #define TRANSMITTER_H
 
+#include <stdint.h>
+
+typedef enum {
+	TRANSMIT_Disabled,
+	TRANSMIT_TurnOff,
+	TRANSMIT_TurnOn,
+	TRANSMIT_Value
+} TransmitState;
+
 void InitTransmitter();
 void UpdateTransmitter();
 void StartTransmitting(bool on);
@@ -30,5 +39,11 @@ uint8_t GetTransmitterState();
 uint32_t GetTransmitWord();
 void StartTransmittingValue(uint16_t value);
 uint8_t IsTransmitting();
+// Number of complete frames sent by the interrupt handler (wraps)
+uint32_t GetTransmittedFrameCount();
+// True if the transmit output could change state within guard_us
+// either side of the next window_us (so that noisy ADC samples can be
+// thrown away)
+bool IsNearTransmitEdge(uint16_t window_us, uint16_t guard_us);
 
 #endif
@@ -25,14 +25,30 @@
 #include "Pins.h"
 #include "DefinedPins.h"
 #include "Clock.h"
+#include "Profiler.h"
 #include <assert.h>
 
-#if defined(WEACT_BLACKPILL_F411CE) or defined(ST_NUCLEO_F411RE)
-#define BASE_BAUD_DIVIDER ((uint16_t) 625) // 72 MHz clock divided by 625 gives 115200 baud
-#else
+#if not (defined(WEACT_BLACKPILL_F411CE) or defined(ST_NUCLEO_F411RE))
 #error Unknown clock frequency; cannot configure UART
 #endif
 
+// The baud rate divider is calculated from the actual peripheral clock.
+// Rates that are too fast for 16x oversampling use 8x oversampling
+// (OVER8), which allows up to the peripheral clock / 8; the interrupt
+// buffers limit the usable rate well below that (MAX_BAUD_RATE).
+#define MIN_DIVIDER ((uint32_t) 8U)
+// Maximum acceptable baud rate error in parts per thousand
+#define MAX_BAUD_ERROR_PPT ((uint32_t) 20U)
+
+// After changing the baud rate, the other end must confirm that it can
+// receive at the new rate within this time or we go back to the default
+#define BAUD_CONFIRMATION_TIMEOUT_MS ((uint32_t) 3000U)
+
+// If the transmitter doesn't go idle within this time of a baud rate
+// change being requested (e.g. because output is continuous), the
+// request is dropped
+#define BAUD_REQUEST_TIMEOUT_MS ((uint32_t) 1000U)
+
 /** Determine whether a byte has been received by the selected UART. */
 #define byteReceived(USART)  ((((USART->SR) & USART_SR_RXNE) == USART_SR_RXNE) && (((USART->CR1) & USART_CR1_RXNEIE) == USART_CR1_RXNEIE))
 /** Determine whether the transmit buffer is empty for the selected UART. */
@@ -42,8 +58,8 @@
 #define IRQDisableTransmitter(USART)    DO(USART->CR1 &= (uint16_t) ~USART_CR1_TXEIE;)
 #define IRQDisableReceiver(USART)       DO(USART->CR1 &= (uint16_t) ~USART_CR1_RXNEIE;)
 
-/* Small buffer for ISR to use with volatile data/indices */
-#define ISRBUFSIZE 20u
+/* Small buffer for ISR to use with volatile data/indices (size is
+ * defined in Uart.h) */
 static volatile uint8_t isrRxBuffer[ISRBUFSIZE];
 static uint8_t isrTxBuffer[ISRBUFSIZE];
 static uint16_t isrTxWriteIndex;
@@ -52,6 +68,16 @@ static volatile uint16_t isrRxWriteIndex;
 static uint16_t isrRxReadIndex;
 static const uint16_t isrBufLen = ISRBUFSIZE;
 
+/* Main buffers (serviced once per millisecond).  There's only one
+ * Uart instance, so these are allocated statically like the ISR buffers */
+static CircularBuffer outgoingStorage;
+static CircularBuffer incomingStorage;
+
+/* Statistics for sizing the ISR buffers */
+static volatile uint32_t isrRxOverrunCount;
+static uint16_t isrRxHighWaterMark;
+static uint16_t isrTxHighWaterMark;
+
 #define USB_UART
 
 #ifdef USB_UART
@@ -62,9 +88,7 @@ static const uint16_t isrBufLen = ISRBUFSIZE;
 
 #if UART_NUMBER == 2
 // UART 2 runs of APB1, which is half the speed of APB2
-// +1 is due to rounding down effect of right-shift - the
-// numbers work better with the plus 1.
-#define BAUD_DIVIDER ((uint16_t) ((BASE_BAUD_DIVIDER+1) >> 1))
+#define UART_CLOCK_HZ GetAPB1ClockHz()
 #define UART_IRQHandler USART2_IRQHandler
 #define UART_STRUCT USART2
 #define UART_TX_PIN_AF UART_TX_PIN, 7
@@ -72,7 +96,7 @@ static const uint16_t isrBufLen = ISRBUFSIZE;
 #define UART_IRQ USART2_IRQn
 #elif UART_NUMBER == 6
 // UART 6 runs of APB2
-#define BAUD_DIVIDER BASE_BAUD_DIVIDER
+#define UART_CLOCK_HZ GetAPB2ClockHz()
 #define UART_IRQHandler USART6_IRQHandler
 #define UART_STRUCT USART6
 #define UART_TX_PIN_AF GPIOC, 6, 8
@@ -84,16 +108,27 @@ static const uint16_t isrBufLen = ISRBUFSIZE;
 
 static bool rxFull(void);
 
+// In RAM (with rxFull) so that bytes aren't lost while flash is being
+// erased
 extern "C" void UART_IRQHandler(void);
-extern "C" void UART_IRQHandler(void)
+extern "C" RAMFUNC void UART_IRQHandler(void)
 {
 	uint8_t rxData;
 	USART_TypeDef *USART = UART_STRUCT;
 
+	PROFILE_START(start_cycles);
+
 	/* --------------------------------------------- */
 	/* Byte received */
 	if (byteReceived(USART))
 	{
+		/* Overrun means that at least one byte has been lost (usually
+		 * because the receiver was disabled while the buffer was full) */
+		if ((USART->SR & USART_SR_ORE) == USART_SR_ORE)
+		{
+			isrRxOverrunCount++;
+		} /* if */
+
 		/* Get data; clears interrupt and error flags */
 		rxData = (uint8_t) USART->DR;
 
@@ -143,25 +178,37 @@ extern "C" void UART_IRQHandler(void)
 			IRQDisableTransmitter(USART);
 		} /* else */
 	} /* if */
+
+	PROFILE_END(UartIsrProfile, start_cycles);
 }
 
 void Uart::Init()
 {
 	USART_TypeDef *USART = UART_STRUCT;
-	this->outgoingBuffer = new CircularBuffer();
-	this->incomingBuffer = new CircularBuffer();
+	this->outgoingBuffer = &outgoingStorage;
+	this->incomingBuffer = &incomingStorage;
+	this->outgoingBuffer->clear();
+	this->incomingBuffer->clear();
+
+	/* Lose new debug output rather than stalling the main loop; hold
+	 * back received data in the ISR buffer until there's space for it */
+	this->outgoingBuffer->setOverflowPolicy(OverflowDropNewest);
+	this->incomingBuffer->setOverflowPolicy(OverflowBlock);
 
 	isrTxReadIndex = 0;
 	isrTxWriteIndex = 0;
 	isrRxReadIndex = 0;
 	isrRxWriteIndex = 0;
 
+	this->awaitingConfirmation = false;
+	this->requestedBaudRate = 0U;
+
 	/* Set up USART */
-	USART->BRR = BAUD_DIVIDER;
 	USART->CR3 = 0x00; /* Default; no flow control or special features */
 	USART->CR2 = USART_CR2_LBDL; /* detect break after 11 bits */
 
 	USART->CR1 = USART_CR1_UE | USART_CR1_TE | USART_CR1_RE;
+	this->SetBaudRate(DEFAULT_BAUD_RATE);
 
 	/* Enable Rx interrupt */
 	USART->CR1 |= USART_CR1_RXNEIE;
@@ -190,6 +237,13 @@ void Uart::Update(void)
 	uint16_t bytesAvailableToTx;
 	uint16_t bytesAvailableToRx;
 
+	if ((this->requestedBaudRate == 0U) && this->awaitingConfirmation
+			&& MillisecondsHaveElapsed(this->confirmationTimer, BAUD_CONFIRMATION_TIMEOUT_MS)) {
+		/* Nothing heard at the new rate: go back to the default */
+		this->awaitingConfirmation = false;
+		this->SetBaudRate(DEFAULT_BAUD_RATE);
+	}
+
 	IRQDisableTransmitter(USART);
 
 	/* Push Bytes */
@@ -219,6 +273,16 @@ void Uart::Update(void)
 		bytesToAddToBuffer--;
 	} /* while */
 
+	if (isrTxWriteIndex >= isrTxReadIndex) {
+		bytesAvailableToTx = isrTxWriteIndex - isrTxReadIndex;
+	}
+	else {
+		bytesAvailableToTx = (isrBufLen - isrTxReadIndex) + isrTxWriteIndex;
+	}
+	if (bytesAvailableToTx > isrTxHighWaterMark) {
+		isrTxHighWaterMark = bytesAvailableToTx;
+	}
+
 	if (isrTxWriteIndex != isrTxReadIndex)
 	{
 		IRQEnableTransmitter(USART);
@@ -240,9 +304,17 @@ void Uart::Update(void)
 				+ writeIndex);
 	}
 
-	bytesToAddToBuffer = incomingBuffer->getSpace();
-	if (bytesAvailableToRx > bytesToAddToBuffer) {
-		bytesAvailableToRx = bytesToAddToBuffer;
+	if (bytesAvailableToRx > isrRxHighWaterMark) {
+		isrRxHighWaterMark = bytesAvailableToRx;
+	}
+
+	/* If blocking, leave anything that won't fit in the ISR buffer;
+	 * otherwise the incoming buffer's overflow policy applies */
+	if (incomingBuffer->getOverflowPolicy() == OverflowBlock) {
+		bytesToAddToBuffer = incomingBuffer->getSpace();
+		if (bytesAvailableToRx > bytesToAddToBuffer) {
+			bytesAvailableToRx = bytesToAddToBuffer;
+		}
 	}
 	while (bytesAvailableToRx > 0) {
 		incomingBuffer->addEntry(isrRxBuffer[isrRxReadIndex]);
@@ -257,12 +329,141 @@ void Uart::Update(void)
 	}
 
 	IRQEnableReceiver(USART);
+
+	/* Baud rate change: wait until everything sent at the old rate
+	 * (including the acknowledgement of the request) has gone.  The
+	 * buffers are still serviced in the meantime. */
+	if (this->requestedBaudRate != 0U) {
+		if (this->IsTransmitIdle()) {
+			this->SetBaudRate(this->requestedBaudRate);
+			this->requestedBaudRate = 0U;
+			this->confirmationTimer = GetMillisecondCounter();
+		}
+		else if (MillisecondsHaveElapsed(this->requestTimer, BAUD_REQUEST_TIMEOUT_MS)) {
+			this->requestedBaudRate = 0U;
+			this->awaitingConfirmation = false;
+		}
+		else {
+			/* Keep waiting */
+		}
+	}
+}
+
+/* --------------------------------------------------------------- */
+
+/*
+ * Calculate the divider for the requested baud rate and, if it's
+ * achievable, program the USART.  Must only be called when the
+ * transmitter is idle.
+ */
+void Uart::SetBaudRate(uint32_t baud)
+{
+	USART_TypeDef *USART = UART_STRUCT;
+	uint32_t clock = UART_CLOCK_HZ;
+	/* Clock divided by baud rate (rounded) is 16 * USARTDIV with
+	 * OVER8 = 0 or 8 * USARTDIV with OVER8 = 1 */
+	uint32_t divider = (clock + (baud >> 1)) / baud;
+	bool over8 = (divider < (MIN_DIVIDER << 1));
+
+	USART->CR1 &= ~USART_CR1_UE;
+	if (over8) {
+		/* Fraction is only 3 bits with OVER8 (bit 3 must be clear) */
+		USART->BRR = ((divider >> 3) << 4) | (divider & 0x7U);
+		USART->CR1 |= USART_CR1_OVER8;
+	}
+	else {
+		USART->BRR = divider;
+		USART->CR1 &= ~USART_CR1_OVER8;
+	}
+	USART->CR1 |= USART_CR1_UE;
+
+	this->baudRate = baud;
+}
+
+/*
+ * Ask for a baud rate change.  The change happens once everything
+ * queued so far has been sent, and must then be confirmed with
+ * ConfirmBaudRate() or the UART reverts to the default rate.  Returns
+ * false (and changes nothing) if the rate is faster than the interrupt
+ * buffers can keep up with or can't be generated accurately from the
+ * peripheral clock.
+ */
+bool Uart::RequestBaudRate(uint32_t baud)
+{
+	uint32_t clock = UART_CLOCK_HZ;
+	uint32_t divider;
+	uint32_t actual;
+	uint32_t error;
+
+	if ((baud == 0U) || (baud > MAX_BAUD_RATE) || (baud > (clock / MIN_DIVIDER))) {
+		return false;
+	}
+
+	divider = (clock + (baud >> 1)) / baud;
+	actual = clock / divider;
+	error = (actual > baud) ? (actual - baud) : (baud - actual);
+	if ((error * 1000U) > (baud * MAX_BAUD_ERROR_PPT)) {
+		return false;
+	}
+
+	this->requestedBaudRate = baud;
+	this->requestTimer = GetMillisecondCounter();
+	/* No confirmation needed to go back to the default */
+	this->awaitingConfirmation = (baud != DEFAULT_BAUD_RATE);
+	return true;
+}
+
+void Uart::ConfirmBaudRate(void)
+{
+	this->awaitingConfirmation = false;
+}
+
+uint32_t Uart::GetBaudRate(void)
+{
+	return this->baudRate;
+}
+
+/*
+ * Returns true if there's nothing waiting to be sent and the last byte
+ * has been shifted out.
+ */
+bool Uart::IsTransmitIdle(void)
+{
+	USART_TypeDef *USART = UART_STRUCT;
+
+	return (outgoingBuffer->isEmpty()
+			&& (isrTxReadIndex == isrTxWriteIndex)
+			&& ((USART->SR & USART_SR_TC) == USART_SR_TC));
+}
+
+/* Nothing to send, nothing received and no baud rate change pending */
+bool Uart::IsIdle(void)
+{
+	return (this->IsTransmitIdle()
+			&& (isrRxReadIndex == isrRxWriteIndex)
+			&& incomingBuffer->isEmpty()
+			&& (this->requestedBaudRate == 0U));
+}
+
+uint16_t Uart::GetIsrRxHighWaterMark(void)
+{
+	return isrRxHighWaterMark;
+}
+
+uint16_t Uart::GetIsrTxHighWaterMark(void)
+{
+	return isrTxHighWaterMark;
+}
+
+uint32_t Uart::GetIsrRxOverrunCount(void)
+{
+	return isrRxOverrunCount;
 }
 
 /**
  * Returns true if Rx buffer is full; only called by interrupt.
  */
-static bool rxFull(void)
+RAMFUNC static bool rxFull(void)
 {
 	// Local copy of volatile
 	uint16_t copyIsrRxWriteIndex;
@@ -21,15 +21,46 @@
 #ifndef UART_H
 #define UART_H
 
+#include <stdint.h>
+
+/* Size of the buffers used by the interrupt handler.  The buffers are
+ * only serviced once per millisecond, so they must hold at least a
+ * millisecond's worth of data at the fastest baud rate. */
+#define ISRBUFSIZE 256u
+
+/* Fastest baud rate the interrupt buffers can keep up with: a byte is
+ * ten bits on the line, one byte of each buffer is always free and a
+ * fifth is kept spare for a late tick.  This comes to 2.04 Mbaud, so
+ * 2 Mbaud is the fastest standard rate. */
+#define MAX_BAUD_RATE ((uint32_t) ((ISRBUFSIZE - 1u) * 10u * 1000u * 4u / 5u))
+
 class CircularBuffer;
 
+#define DEFAULT_BAUD_RATE ((uint32_t) 115200U)
+
 class Uart
 {
 	public:
 		void Init();
 		void Update(void);
+		bool RequestBaudRate(uint32_t baud);
+		void ConfirmBaudRate(void);
+		uint32_t GetBaudRate(void);
+		bool IsTransmitIdle(void);
+		bool IsIdle(void);
+		uint16_t GetIsrRxHighWaterMark(void);
+		uint16_t GetIsrTxHighWaterMark(void);
+		uint32_t GetIsrRxOverrunCount(void);
 		CircularBuffer *outgoingBuffer;
 		CircularBuffer *incomingBuffer;
+
+	private:
+		void SetBaudRate(uint32_t baud);
+		uint32_t baudRate;
+		uint32_t requestedBaudRate;
+		uint32_t requestTimer;
+		bool awaitingConfirmation;
+		uint32_t confirmationTimer;
 };
 
 #endif /* NOT def UART_H */
@@ -0,0 +1,190 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Usage statistics (hour meter) kept in the persistent store
+
+#include "Global.h"
+#include "Clock.h"
+#include "Usage.h"
+#include "Store.h"
+#include "Analogue.h"
+#include "Transmitter.h"
+
+#include <assert.h>
+
+// List of counters (with the names used by the "usage" command)
+static const struct {
+	UsageCounter name;
+	const char *displayname;
+} UsageList[USAGE_COUNT] = {
+	{VacuumCyclesUsage,    "vacuum_cycles"},
+	{VacuumOnSecondsUsage, "vacuum_on_s"},
+	{ToolRunsUsage,        "tool_runs"},
+	{ToolOnSecondsUsage,   "tool_on_s"},
+	{PeakCurrentUsage,     "peak_current"},
+	{ChargeUsage,          "charge"},
+	{OnFramesUsage,        "on_frames"},
+	{OffFramesUsage,       "off_frames"},
+};
+
+static uint32_t totals[USAGE_COUNT];
+static bool changed = false;
+
+// Parts of a second (or ADC unit second) not yet added to the totals
+static uint32_t vacuum_on_ms = 0U;
+static uint32_t tool_on_ms = 0U;
+static uint32_t charge_ms = 0U;
+
+static bool vacuum_on = false;
+static bool tool_on = false;
+
+static uint32_t last_sample_time;
+static uint32_t last_flush_time;
+static uint32_t last_frame_count;
+
+static uint16_t StoreKey(UsageCounter counter)
+{
+	return (uint16_t) (STORE_USAGE_FIRST_KEY + (uint16_t) counter);
+}
+
+static void Increment(UsageCounter counter, uint32_t amount)
+{
+	if (amount > 0U) {
+		totals[(int) counter] += amount;
+		changed = true;
+	}
+}
+
+// Add milliseconds to a total kept in seconds
+static void AddMilliseconds(UsageCounter counter, uint32_t *remainder, uint32_t amount)
+{
+	*remainder += amount;
+	Increment(counter, *remainder / 1000U);
+	*remainder %= 1000U;
+}
+
+static void Flush(uint32_t now)
+{
+	for (int i=0;i<USAGE_COUNT;i++) {
+		(void) WriteStoreValue(StoreKey((UsageCounter) i), totals[i]);
+	}
+	changed = false;
+	last_flush_time = now;
+}
+
+void InitUsage()
+{
+	static_assert(USAGE_COUNT <= STORE_USAGE_KEY_COUNT, "Too many usage counters for the store");
+
+	for (int i=0;i<USAGE_COUNT;i++) {
+		// Check that the counters are in the right order in the array
+		assert(UsageList[i].name == ((int) i));
+
+		if ( ! ReadStoreValue(StoreKey((UsageCounter) i), &totals[i])) {
+			totals[i] = 0U;
+		}
+	}
+
+	last_sample_time = GetMillisecondCounter();
+	last_flush_time = last_sample_time;
+	last_frame_count = GetTransmittedFrameCount();
+}
+
+void UpdateUsage()
+{
+	uint32_t now = GetMillisecondCounter();
+	uint32_t elapsed = now - last_sample_time;
+	last_sample_time = now;
+
+	uint16_t current = GetAnalogueCurrent();
+	bool tool_running = (current > GetLowCurrentThreshold());
+	if (tool_running) {
+		if ( ! tool_on) {
+			Increment(ToolRunsUsage, 1U);
+		}
+		AddMilliseconds(ToolOnSecondsUsage, &tool_on_ms, elapsed);
+		AddMilliseconds(ChargeUsage, &charge_ms, (uint32_t) current * elapsed);
+		if (current > totals[(int) PeakCurrentUsage]) {
+			totals[(int) PeakCurrentUsage] = current;
+			changed = true;
+		}
+	}
+	tool_on = tool_running;
+
+	TransmitState state = (TransmitState) GetTransmitterState();
+	bool vacuum_running = (state == TRANSMIT_TurnOn);
+	if (vacuum_running) {
+		if ( ! vacuum_on) {
+			Increment(VacuumCyclesUsage, 1U);
+		}
+		AddMilliseconds(VacuumOnSecondsUsage, &vacuum_on_ms, elapsed);
+	}
+	vacuum_on = vacuum_running;
+
+	// Frames are counted against whatever is being sent now, which is
+	// out by at most a frame or two when the state changes
+	uint32_t frame_count = GetTransmittedFrameCount();
+	if (state == TRANSMIT_TurnOn) {
+		Increment(OnFramesUsage, frame_count - last_frame_count);
+	}
+	else if (state == TRANSMIT_TurnOff) {
+		Increment(OffFramesUsage, frame_count - last_frame_count);
+	}
+	else {
+		// Current values (diagnostics) aren't counted
+	}
+	last_frame_count = frame_count;
+
+	// Limit how often the flash is written: the totals are normally
+	// flushed once everything has stopped
+	uint32_t since_flush = now - last_flush_time;
+	if (changed && (since_flush >= USAGE_FLUSH_MIN_MS)
+			&& ((( ! tool_on) && ( ! vacuum_on)) || (since_flush >= USAGE_FLUSH_MAX_MS))) {
+		Flush(now);
+	}
+}
+
+uint32_t GetUsage(UsageCounter counter)
+{
+	return totals[(int) counter];
+}
+
+const char *GetUsageName(UsageCounter counter)
+{
+	return UsageList[(int) counter].displayname;
+}
+
+uint32_t GetAverageToolCurrent()
+{
+	if (totals[(int) ToolOnSecondsUsage] == 0U) {
+		return 0U;
+	}
+	return totals[(int) ChargeUsage] / totals[(int) ToolOnSecondsUsage];
+}
+
+void ResetUsage()
+{
+	for (int i=0;i<USAGE_COUNT;i++) {
+		totals[i] = 0U;
+	}
+	vacuum_on_ms = 0U;
+	tool_on_ms = 0U;
+	charge_ms = 0U;
+	Flush(GetMillisecondCounter());
+}
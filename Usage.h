@@ -0,0 +1,70 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Usage statistics (hour meter) kept in the persistent store
+//
+// The totals are sampled every USAGE_SAMPLE_MS and kept in RAM.  They
+// are copied into the store (see Store.h) at most once every
+// USAGE_FLUSH_MIN_MS: when the tool and vacuum have stopped, or after
+// USAGE_FLUSH_MAX_MS if they keep running.  Anything since the last
+// flush is lost if the power is removed.
+//
+// Each flush adds a record for every changed counter, so with a cut
+// every few minutes the store's log fills up and is compacted every day
+// or two.  The old sector is then erased the next time everything is
+// idle, which stalls the main loop but not the millisecond count or the
+// UART (see EraseFlashSector).
+
+#ifndef USAGE_H
+#define USAGE_H
+
+#include <stdint.h>
+
+#define USAGE_SAMPLE_MS ((uint32_t) 100U)
+#define USAGE_FLUSH_MIN_MS ((uint32_t) 60000U)
+#define USAGE_FLUSH_MAX_MS ((uint32_t) 900000U)
+
+// The position in this list is the key in the store, so new counters
+// go at the end.
+typedef enum _UsageCounters
+{
+	VacuumCyclesUsage,
+	VacuumOnSecondsUsage,
+	ToolRunsUsage,
+	ToolOnSecondsUsage,
+	PeakCurrentUsage,   // ADC units
+	ChargeUsage,        // ADC unit seconds
+	OnFramesUsage,
+	OffFramesUsage,
+	LastUsageIndex = OffFramesUsage
+} UsageCounter;
+
+#define USAGE_COUNT (((int) LastUsageIndex)+1)
+
+void InitUsage();
+void UpdateUsage();
+
+uint32_t GetUsage(UsageCounter counter);
+const char *GetUsageName(UsageCounter counter);
+// Average current while the tool was running, in ADC units
+uint32_t GetAverageToolCurrent();
+// Clear all of the totals (in flash too)
+void ResetUsage();
+
+#endif
@@ -21,10 +21,26 @@
 #include <stdlib.h>
 #include <stddef.h>
 #include <reent.h>
+#include <string.h>
+#include <errno.h>
 #include "cmsis.h"
+#include "MemoryUsage.h"
+
+extern uint32_t g_pfnVectors[];
 
 void SystemInit(void)
 {
+	// Take the interrupt vectors from a copy in RAM so that interrupts
+	// aren't held off while flash is being erased (the handlers that
+	// matter are in RAM too: see RAMFUNC in Global.h)
+	uint32_t *ram_vectors = (uint32_t *) NVIC_RAM_VECTOR_ADDRESS;
+	for (uint32_t i=0U;i<NVIC_NUM_VECTORS;i++) {
+		ram_vectors[i] = g_pfnVectors[i];
+	}
+	__DSB();
+	SCB->VTOR = NVIC_RAM_VECTOR_ADDRESS;
+	__DSB();
+
 	// Make sure peripheral power is turned on
 	RCC->AHB1LPENR = (uint32_t) 0
 		| RCC_AHB1LPENR_GPIOALPEN
@@ -34,7 +50,8 @@ void SystemInit(void)
 		| RCC_AHB1LPENR_SRAM1LPEN;  /* Enable in sleep mode */
 	RCC->APB1LPENR = (uint32_t) 0
 		| RCC_APB1LPENR_USART2LPEN
-		| RCC_APB1LPENR_TIM2LPEN;
+		| RCC_APB1LPENR_TIM2LPEN
+		| RCC_APB1LPENR_TIM3LPEN; /* ADC trigger during tickless idle */
 	RCC->APB2LPENR = (uint32_t) 0
 		| RCC_APB2LPENR_SYSCFGLPEN
 		| RCC_APB2LPENR_ADC1LPEN;
@@ -45,6 +62,7 @@ void SystemInit(void)
 	RCC->APB1ENR = (uint32_t) 0
 		| RCC_APB1ENR_USART2EN
 		| RCC_APB1ENR_TIM2EN
+		| RCC_APB1ENR_TIM3EN
 		| RCC_APB1ENR_PWREN;
 	RCC->APB2ENR = (uint32_t) 0
 		| RCC_APB2ENR_SYSCFGEN
@@ -54,6 +72,9 @@ void SystemInit(void)
 extern int __real_main(void);
 int __wrap_main(void)
 {
+	// Fill the stack with a known pattern so that the deepest point
+	// reached can be found later
+	PaintStack();
 	return __real_main();
 }
 
@@ -62,37 +83,93 @@ void __wrap_exit(int return_code)
 	while (1) {}
 }
 
+#ifdef NO_HEAP
+/* Static build: everything is allocated statically, so the heap wrappers
+ * are deliberately left out.  Anything that calls malloc, new, etc (or a
+ * library function that needs them, such as stdio) then fails to link
+ * with an undefined reference to __wrap__malloc_r or similar.
+ */
+
+/* The library's assert handler prints with fiprintf, which needs the
+ * heap: just stop here instead (the debugger shows the arguments). */
+void __assert_func(const char *file, int line, const char *func, const char *expr)
+{
+	(void) file;
+	(void) line;
+	(void) func;
+	(void) expr;
+	__disable_irq();
+	while (1) {}
+}
+#else
 extern void *__real__malloc_r(struct _reent *r, size_t size);
 extern void __real__free_r(struct _reent *r, void *ptr);
 extern void *__real__realloc_r(struct _reent *r, void *ptr, size_t size);
 extern void *__real__calloc_r(struct _reent *r, size_t nmemb, size_t size);
 
+// The wrappers keep track of heap usage (see MemoryUsage.h)
 void *__wrap__malloc_r(struct _reent *r, size_t size)
 {
 	void *ptr = NULL;
 	ptr = __real__malloc_r(r, size);
+	RecordAllocation(ptr, size);
 	return ptr;
 }
 
 void __wrap__free_r(struct _reent *r, void *ptr)
 {
+	RecordFree(GetBlockSize(ptr));
 	__real__free_r(r, ptr);
 }
 
 
+// realloc and calloc are built on the malloc and free wrappers (rather
+// than calling the library versions) as the library versions may call
+// _malloc_r/_free_r themselves, which would then be counted twice
 void *__wrap__realloc_r(struct _reent *r, void *ptr, size_t size)
 {
 	void *new_ptr = NULL;
-	new_ptr = __real__realloc_r(r, ptr, size);
+	size_t old_size;
+
+	if (ptr == NULL) {
+		return __wrap__malloc_r(r, size);
+	}
+	if (size == 0U) {
+		__wrap__free_r(r, ptr);
+		return NULL;
+	}
+
+	old_size = GetBlockSize(ptr);
+	if (old_size >= size) {
+		// Already big enough
+		return ptr;
+	}
+
+	new_ptr = __wrap__malloc_r(r, size);
+	if (new_ptr != NULL) {
+		memcpy(new_ptr, ptr, old_size);
+		__wrap__free_r(r, ptr);
+	}
 	return new_ptr;
 }
 
 void *__wrap__calloc_r(struct _reent *r, size_t nmemb, size_t size)
 {
 	void *ptr = NULL;
-	ptr = __real__calloc_r(r, nmemb, size);
+	size_t total = nmemb * size;
+
+	if ((size != 0U) && ((total / size) != nmemb)) {
+		// Overflow
+		r->_errno = ENOMEM;
+		return NULL;
+	}
+	ptr = __wrap__malloc_r(r, total);
+	if (ptr != NULL) {
+		memset(ptr, 0, total);
+	}
 	return ptr;
 }
+#endif
 
 void __HAL_RCC_AFIO_CLK_ENABLE(void) {
 	/* Called by hal_gpio, but implemented elsewhere */
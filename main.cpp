@@ -25,12 +25,38 @@
 #include "Clock.h"
 #include "PrintSupport.h"
 #include "Pins.h"
+#include "Store.h"
+#include "Usage.h"
+#include "Settings.h"
+#include "Timers.h"
 #include "Switches.h"
+#include "Gestures.h"
 #include "Debug.h"
 #include "Application.h"
+#include "Analogue.h"
 #include "DefinedPins.h"
+#include "Profiler.h"
+#include "LoopMonitor.h"
+#include "Scheduler.h"
+#include "Trace.h"
+#include "MemoryUsage.h"
 #include "tinyprintf.h"
 
+#ifdef TICKLESS_IDLE
+// Milliseconds until the main loop next has something to do: one if it
+// needs to run every tick, otherwise limited by the timers and the
+// slower scheduler tasks (StartTicklessIdle limits it to what SysTick
+// can count).  The ADC carries on sampling while asleep and wakes the
+// core if the current rises (see StartAnalogueWatch).
+static uint32_t GetIdleTime()
+{
+	if ( ! (IsApplicationIdle() && IsDebugIdle() && IsPrintSupportIdle() && IsStoreIdle())) {
+		return 1U;
+	}
+	return GetTimeToNextTask(GetTimeToNextTimer(UINT32_MAX));
+}
+#endif
+
 int main()
 {
 	// NOTE: the SystemInit function is called from the start-up code prior to running main!
@@ -40,26 +66,58 @@ int main()
 	SetPinAsGPO_PP(LOOPTIME_PIN); // B10
 
 	SetupClocks();
+#ifdef PROFILING
+	InitProfiler();
+#endif
+#ifdef TRACING
+	InitTrace();
+#endif
+	InitStore();
+	InitSettings();
+	InitTimers();
 	InitSwitches();
+	InitGestures();
 	InitPrintSupport();
 	InitApplication();
+	InitUsage();
 	InitDebug();
+	InitScheduler();
 
 	putstring("\fStarting..\n");
 
+	// Any allocation from here on is reported separately
+	SetInitialisationComplete();
+
 	while (true) {
 		// LOOPTIME_PIN is used to measure how long the main loop is taking
 		// (in order to ensure that it is << 1 ms and we're not overworking the
 		// microcontroller).
-		SetPinState(LOOPTIME_PIN, true);
+		LoopTimePin::Set();
 
 		// Loop runs once per millisecond for non-time-critical updates
-		UpdatePrintSupport();
-		UpdateSwitches();
-		UpdateDebug();
-		UpdateApplication();
+		StartLoopMonitor();
+
+		RunScheduler();
+
+		// Check whether the loop finished within its millisecond
+		EndLoopMonitor();
+
+		LoopTimePin::Clear();
 
-		SetPinState(LOOPTIME_PIN, false);
+#ifdef TICKLESS_IDLE
+		uint32_t idle_time = GetIdleTime();
+		if (idle_time > 1U) {
+			// Sleep until the stretched tick or any other interrupt (e.g.
+			// a received character or the current rising) and then run
+			// the loop again
+			StartAnalogueWatch();
+			StartTicklessIdle(idle_time);
+			__WFI();
+			EndTicklessIdle();
+			EndAnalogueWatch();
+			continue;
+		}
+#endif
 
 		/* Enter wait mode, and do not exit until SysTick_Handler() clears
 		   sleep-on-exit bit. System will respond to other interrupts,
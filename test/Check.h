@@ -0,0 +1,54 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Minimal checking for the host tests: each failed check is reported,
+// and the test's exit status is the number of failures
+
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <stdio.h>
+
+static int check_failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if ( ! (condition)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+			check_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_EQUAL(expected, actual) \
+	do { \
+		unsigned long long check_e = (unsigned long long) (expected); \
+		unsigned long long check_a = (unsigned long long) (actual); \
+		if (check_e != check_a) { \
+			fprintf(stderr, "%s:%d: check failed: %s == %s (%llu != %llu)\n", \
+					__FILE__, __LINE__, #expected, #actual, check_e, check_a); \
+			check_failures++; \
+		} \
+	} while (0)
+
+#define CHECK_RESULT() \
+	(((check_failures) == 0) \
+		? (fprintf(stderr, "%s: passed\n", __FILE__), 0) \
+		: (fprintf(stderr, "%s: %d failed\n", __FILE__, check_failures), 1))
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Synthetic current traces for testing the start detection
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <assert.h>
+
+#include "CurrentTraces.h"
+
+#define NOISE_RMS 4.0
+#define SAMPLE_MAX 2047
+
+static const struct {
+	TraceKind kind;
+	const char *displayname;
+} TraceKindList[TRACE_KIND_COUNT] = {
+	{MotorStartTrace,   "motor start"},
+	{SpikeTrace,        "spike 1-3 ms"},
+	{BurstTrace,        "burst 20-40 ms"},
+	{SubThresholdTrace, "sub-threshold load"},
+};
+
+static double Uniform(double low, double high)
+{
+	return low + ((high - low) * rand() / (double) RAND_MAX);
+}
+
+// Box-Muller
+static double Gaussian()
+{
+	double u = (rand() + 1.0) / (RAND_MAX + 2.0);
+	double v = (rand() + 1.0) / (RAND_MAX + 2.0);
+	return sqrt(-2.0 * log(u)) * cos(2.0 * M_PI * v);
+}
+
+void MakeCurrentTrace(TraceKind kind, uint16_t *samples, int length, int start_ms)
+{
+	double peak = Uniform(150.0, 600.0);
+	double running = Uniform(80.0, 300.0);
+	double decay_ms = Uniform(20.0, 100.0);
+	double rise_ms = Uniform(0.5, 3.0);
+	double amplitude = Uniform(100.0, 800.0);
+	double level = Uniform(20.0, 60.0);
+	int burst_ms = (int) Uniform(20.0, 40.0);
+	int spike_ms = (int) Uniform(1.0, 3.0);
+
+	for (int t=0;t<length;t++) {
+		double current = 0.0;
+		int since = t - start_ms;
+		if (since >= 0) {
+			switch (kind) {
+				case MotorStartTrace:
+					current = running + ((peak - running) * exp(-since / decay_ms));
+					if (since < rise_ms) {
+						current *= since / rise_ms;
+					}
+					break;
+				case SpikeTrace:
+					if (since < spike_ms) {
+						current = amplitude;
+					}
+					break;
+				case BurstTrace:
+					if (since < burst_ms) {
+						current = amplitude * 0.5;
+					}
+					break;
+				case SubThresholdTrace:
+				default:
+					current = level * (1.0 - exp(-since / 30.0));
+					break;
+			}
+		}
+		long sample = lround(current + (Gaussian() * NOISE_RMS));
+		if (sample < 0) {
+			sample = 0;
+		}
+		if (sample > SAMPLE_MAX) {
+			sample = SAMPLE_MAX;
+		}
+		samples[t] = (uint16_t) sample;
+	}
+}
+
+const char *GetTraceKindName(TraceKind kind)
+{
+	assert(TraceKindList[(int) kind].kind == kind);
+	return TraceKindList[(int) kind].displayname;
+}
@@ -0,0 +1,45 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Synthetic current traces (one sample per millisecond, in ADC units
+// above the zero offset) for testing the start detection.  Each trace is
+// quiet until the event starts and the event's shape is randomised
+// within the range given for its kind; every sample has Gaussian noise.
+
+#ifndef CURRENTTRACES_H
+#define CURRENTTRACES_H
+
+#include <stdint.h>
+
+typedef enum {
+	MotorStartTrace,      // Inrush peak decaying to a running current
+	SpikeTrace,           // 1-3 ms spike (e.g. a switch on another load)
+	BurstTrace,           // 20-40 ms burst (e.g. a tool blipped on and off)
+	SubThresholdTrace,    // Load step that stays below the thresholds
+	LastTraceKindIndex = SubThresholdTrace
+} TraceKind;
+
+#define TRACE_KIND_COUNT (((int) LastTraceKindIndex)+1)
+
+// Fill samples[0..length-1] with a trace whose event starts at start_ms
+// (uses rand(), so seed with srand for a repeatable set of traces)
+void MakeCurrentTrace(TraceKind kind, uint16_t *samples, int length, int start_ms);
+const char *GetTraceKindName(TraceKind kind);
+
+#endif
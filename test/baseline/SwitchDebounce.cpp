@@ -0,0 +1,133 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Switch Debouncing Functions
+
+#include "Global.h"
+#include "cmsis.h"
+#include "SwitchDebounce.h"
+#include "Pins.h"
+#include "Timers.h"
+#include "Settings.h"
+#include "Trace.h"
+#include "EdgeCapture.h"
+
+#define DEFAULT_STATE false
+#define DEBOUNCE_MS GetSetting(DebounceSetting)
+// Quiet time after the last edge before an interrupt input is read;
+// longer than the contact bounce but well under the polled debounce time
+#define EDGE_SETTLE_MS ((uint32_t) 5U)
+
+void SwitchDebounce::Init(GPIO_TypeDef *port, uint8_t pin, TimerName timer, bool edge_interrupt)
+{
+	this->sw_port = port;
+	this->sw_pin = pin;
+	this->settle_timer = timer;
+
+	SetPinAsInputFloat(port, pin);
+	this->last_state = GetPinState(port, pin);
+	this->initialised = false;
+	this->validated_state = ! this->last_state;
+	this->settling = false;
+	this->first_edge_time = GetTimestamp();
+	this->change_time = this->first_edge_time;
+
+	// Fall back to polling if the EXTI line is already taken
+	this->use_interrupt = edge_interrupt && EnableEdgeCapture(port, pin);
+	if (this->use_interrupt) {
+		StartTimer(timer, EDGE_SETTLE_MS);
+	}
+	else {
+		StartTimer(timer, DEBOUNCE_MS);
+	}
+}
+
+void SwitchDebounce::HandleEdge(Timestamp time)
+{
+	if ( ! this->settling) {
+		this->settling = true;
+		this->first_edge_time = time;
+	}
+	StartTimer(this->settle_timer, EDGE_SETTLE_MS);
+}
+
+void SwitchDebounce::Update()
+{
+	if (this->use_interrupt) {
+		// Nothing to do until the edges have stopped for EDGE_SETTLE_MS
+		if ( ! TimerHasExpired(this->settle_timer)) {
+			return;
+		}
+		bool current_state = GetPinState(this->sw_port, this->sw_pin);
+		if ((current_state != this->validated_state) || ( ! this->initialised)) {
+			TRACE(TraceButtonEdge, (((uint32_t) this->sw_pin) << 1) | (current_state ? 1U : 0U));
+			this->validated_state = current_state;
+			this->change_time = this->first_edge_time;
+			this->initialised = true;
+		}
+		this->settling = false;
+		return;
+	}
+
+	bool current_state = GetPinState(this->sw_port, this->sw_pin);
+	if ((current_state != this->validated_state) || ( ! this->initialised)) {
+		if (current_state != this->last_state) {
+			TRACE(TraceButtonRawEdge, (((uint32_t) this->sw_pin) << 1) | (current_state ? 1U : 0U));
+			StartTimer(this->settle_timer, DEBOUNCE_MS);
+			if ( ! this->settling) {
+				this->settling = true;
+				this->first_edge_time = GetTimestamp();
+			}
+			this->last_state = current_state;
+		}
+		else if (TimerHasExpired(this->settle_timer)) {
+			TRACE(TraceButtonEdge, (((uint32_t) this->sw_pin) << 1) | (current_state ? 1U : 0U));
+			this->validated_state = current_state;
+			this->change_time = this->first_edge_time;
+			this->initialised = true;
+			this->settling = false;
+		}
+		else {
+			// Wait for it to settle
+		}
+	}
+	else {
+		// Bounced back to the validated state
+		this->settling = false;
+	}
+}
+
+bool SwitchDebounce::GetState()
+{
+	if (this->initialised) {
+		return this->validated_state;
+	}
+	else {
+		return DEFAULT_STATE;
+	}
+}
+
+bool SwitchDebounce::IsInitialised()
+{
+	return this->initialised;
+}
+
+Timestamp SwitchDebounce::GetChangeTime()
+{
+	return this->change_time;
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+// Switch Debouncing Functions
+
+#ifndef SWITCHDEBOUNCE_H
+#define SWITCHDEBOUNCE_H
+
+#include "cmsis.h"
+#include "Clock.h"
+#include "Timers.h"
+
+// Polled inputs are sampled every tick and must be stable for the
+// debounce setting.  Edge interrupt inputs (see EdgeCapture.h) are only
+// read once they've been quiet for EDGE_SETTLE_MS after the last edge,
+// so a clean press is accepted within a few milliseconds.
+class SwitchDebounce
+{
+	public:
+		void Init(GPIO_TypeDef *port, uint8_t pin, TimerName timer, bool edge_interrupt);
+		void Update();
+		// For edge interrupt inputs: called for each edge on this pin
+		void HandleEdge(Timestamp time);
+		bool GetState();
+		bool IsInitialised();
+		// Time at which the input first moved towards its current state
+		Timestamp GetChangeTime();
+
+	private:
+		GPIO_TypeDef *sw_port;
+		uint8_t sw_pin;
+		bool use_interrupt;
+
+		bool last_state;
+		bool validated_state;
+		bool initialised;
+		// Runs while waiting for the input to settle
+		TimerName settle_timer;
+		// First edge since the input was last stable
+		bool settling;
+		Timestamp first_edge_time;
+		Timestamp change_time;
+};
+
+#endif
@@ -0,0 +1,78 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark: bufprintf against the per-character printf path
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#include "CircularBuffer.h"
+#include "PrintSupport.h"
+#include "tinyprintf.h"
+
+// Results go to the host's stdout, not the (fake) UART
+#undef printf
+
+#define REPEATS 200000
+#define FIELD_ROWS 7
+
+// The start of a debug screen redraw: a header followed by a column of
+// labelled fields, as the "debug" command draws it
+#define DRAW_SCREEN(PRINT, k) \
+	do { \
+		PRINT("\x1b[2J\x1b[1;1HCordless Vacuum Starter\n" \
+				"Black Pill Version\nChangeset ID: host\n" \
+				"Build Date: host\nVersion: host\nTest #1\n\n"); \
+		for (int row=0;row<FIELD_ROWS;row++) { \
+			PRINT("\x1b[%u;%uH%s", 9 + row, 1, "Millisecond Clock:"); \
+			PRINT("\x1b[%u;%uH0x%08lX", 9 + row, 21, (unsigned long) (k)); \
+		} \
+	} while (0)
+
+template<typename F> static double CharactersPerMicrosecond(F draw)
+{
+	CircularBuffer *outgoing = GetStreamBuffer(OutgoingStream);
+	uint64_t characters = 0U;
+	auto start = std::chrono::steady_clock::now();
+	for (int k=0;k<REPEATS;k++) {
+		outgoing->clear();
+		draw(k);
+		characters += outgoing->getNumEntries();
+	}
+	std::chrono::duration<double, std::micro> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return characters / elapsed.count();
+}
+
+int main()
+{
+	InitPrintSupport();
+
+	double per_char = CharactersPerMicrosecond([](int k) {
+			DRAW_SCREEN(tfp_printf, k);
+	});
+	double span = CharactersPerMicrosecond([](int k) {
+			DRAW_SCREEN(bufprintf, k);
+	});
+
+	printf("per-character printf: %.1f chars/us\n", per_char);
+	printf("bufprintf:            %.1f chars/us (x%.2f)\n", span, span / per_char);
+	return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark: cost per tick of debouncing polled switches, built once per
+// switch count against the current Switches.cpp (port-wide vertical
+// counters) and once against the per-switch debouncer that it replaced
+// (baseline/).  The switch tables are widened by widen_switches.py and
+// every switch is polled (EnableEdgeCapture fails).
+//
+// The time is host time, so it only shows how the two scale with the
+// number of switches.  On the target, build with -D PROFILING and read
+// the UpdateSwitches line of the "profile" command.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#include "cmsis.h"
+#include "Clock.h"
+#include "Timers.h"
+#include "Settings.h"
+#include "Switches.h"
+#include "FakeClock.h"
+#include "PinsStub.h"
+#include "EdgeCaptureStub.h"
+#include "Peripherals.h"
+
+#ifndef BENCH_VARIANT
+#define BENCH_VARIANT "switches"
+#endif
+
+#define SWITCH_COUNT (((int) LastSwitchIndex)+1)
+#define ROUNDS 5
+#define ROUND_TICKS 40000L
+#define DEBOUNCE_MS 100U
+// Each switch changes every TOGGLE_BASE_MS + (n * TOGGLE_STEP_MS) and
+// bounces for BOUNCE_MS after each change
+#define TOGGLE_BASE_MS 400L
+#define TOGGLE_STEP_MS 37L
+#define BOUNCE_MS 3L
+
+static long tick = 0L;
+
+uint32_t GetSetting(SettingName name)
+{
+	return (name == DebounceSetting) ? DEBOUNCE_MS : 0U;
+}
+
+static GPIO_TypeDef *SwitchPort(int index)
+{
+	return (index < 16) ? GPIOA : GPIOB;
+}
+
+// Level of the input at the current tick
+static bool GetInputLevel(int index, long *since_change)
+{
+	long period = TOGGLE_BASE_MS + (index * TOGGLE_STEP_MS);
+	bool level = ((tick / period) & 1L) != 0L;
+	*since_change = tick % period;
+	if ((*since_change < BOUNCE_MS) && ((*since_change & 1L) != 0L)) {
+		level = ! level;
+	}
+	return level;
+}
+
+// Drive both the IDR (read by the port groups) and the stub pin levels
+// (read by GetPinState in the per-switch debouncer)
+static void SetInputs()
+{
+	for (int i=0;i<SWITCH_COUNT;i++) {
+		GPIO_TypeDef *port = SwitchPort(i);
+		uint32_t mask = (uint32_t) 1U << (i % 16);
+		long since_change;
+		bool high = GetInputLevel(i, &since_change);
+		if (high) {
+			port->IDR |= mask;
+		}
+		else {
+			port->IDR &= ~mask;
+		}
+		SetStubPinLevel(port, (uint8_t) (i % 16), high);
+	}
+}
+
+// Host nanoseconds per tick for ROUND_TICKS ticks, with or without the
+// switch update
+static double TimeTicks(bool update_switches)
+{
+	auto start = std::chrono::steady_clock::now();
+	for (long i=0;i<ROUND_TICKS;i++) {
+		tick++;
+		SetInputs();
+		AdvanceFakeMilliseconds(1U);
+		UpdateTimers();
+		if (update_switches) {
+			UpdateSwitches();
+		}
+	}
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return elapsed.count() / ROUND_TICKS;
+}
+
+int main()
+{
+	if ( ! MapGpioPorts()) {
+		fprintf(stderr, "can't map the GPIO registers on this host\n");
+		return 1;
+	}
+
+	SetStubEdgeCaptureAvailable(false);
+	SetFakeMicroseconds(1000000U);
+	SetInputs();
+	InitTimers();
+	InitSwitches();
+
+	// The quickest of several rounds, so that the difference isn't
+	// swamped by the host being busy
+	double with_switches = 0.0;
+	double without_switches = 0.0;
+	for (int round=0;round<ROUNDS;round++) {
+		double full = TimeTicks(true);
+		double timers_only = TimeTicks(false);
+		if ((round == 0) || (full < with_switches)) {
+			with_switches = full;
+		}
+		if ((round == 0) || (timers_only < without_switches)) {
+			without_switches = timers_only;
+		}
+	}
+
+	// Check that every switch that has been steady for a while has been
+	// debounced, rather than timing code that does nothing
+	TimeTicks(true);
+	int wrong = 0;
+	for (int i=0;i<SWITCH_COUNT;i++) {
+		long since_change;
+		bool level = GetInputLevel(i, &since_change);
+		// The switches are active low (false_is_pressed)
+		if ((since_change > (long) (2U * DEBOUNCE_MS))
+				&& (GetSwitchState((SwitchName) i) == level)) {
+			wrong++;
+		}
+	}
+	if (wrong != 0) {
+		fprintf(stderr, "%s: %d switches in the wrong state\n", BENCH_VARIANT, wrong);
+		return 1;
+	}
+
+	printf("%-8s %2d switches: UpdateSwitches %5.1f ns/tick\n",
+			BENCH_VARIANT, SWITCH_COUNT, with_switches - without_switches);
+	return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Benchmark: cost per tick of the timer wheel with N long timers running,
+// against polling N 64-bit deadlines every tick.  Built against a copy
+// of the timer table widened to 100 timers (see widen_timers.py).
+
+#include <stdio.h>
+#include <stdint.h>
+#include <chrono>
+
+#include "Clock.h"
+#include "Timers.h"
+#include "FakeClock.h"
+
+#define TICKS 5000000L
+#define DURATION_MS 100000U
+// Restart the timers before they expire, as a timeout that's normally
+// cancelled would be
+#define RESTART_MS 90000U
+
+static double NanosecondsSince(std::chrono::steady_clock::time_point start)
+{
+	std::chrono::duration<double, std::nano> elapsed =
+		std::chrono::steady_clock::now() - start;
+	return elapsed.count();
+}
+
+static double WheelNanosecondsPerTick(int n)
+{
+	SetFakeMicroseconds(0U);
+	InitTimers();
+	for (int i=0;i<n;i++) {
+		StartTimer((TimerName) i, DURATION_MS);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (long tick=1;tick<=TICKS;tick++) {
+		AdvanceFakeMilliseconds(1U);
+		UpdateTimers();
+		if ((tick % RESTART_MS) == 0) {
+			for (int i=0;i<n;i++) {
+				StartTimer((TimerName) i, DURATION_MS);
+			}
+		}
+	}
+	return NanosecondsSince(start) / TICKS;
+}
+
+static double PollingNanosecondsPerTick(int n)
+{
+	volatile uint64_t deadlines[TIMER_COUNT];
+	volatile uint64_t now = 0U;
+	volatile long expired = 0;
+
+	for (int i=0;i<n;i++) {
+		deadlines[i] = ((uint64_t) DURATION_MS) * 1000U * 1000U;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	for (long tick=1;tick<=TICKS;tick++) {
+		now = now + 1000U;
+		for (int i=0;i<n;i++) {
+			if (((int64_t) (now - deadlines[i])) >= 0) {
+				expired = expired + 1;
+			}
+		}
+	}
+	return NanosecondsSince(start) / TICKS;
+}
+
+int main()
+{
+	static const int counts[] = {1, 10, TIMER_COUNT};
+
+	for (unsigned int k=0;k<(sizeof(counts)/sizeof(counts[0]));k++) {
+		int n = counts[k];
+		printf("N=%3d: wheel %.1f ns/tick, polling %.1f ns/tick\n",
+				n, WheelNanosecondsPerTick(n), PollingNanosecondsPerTick(n));
+	}
+	return 0;
+}
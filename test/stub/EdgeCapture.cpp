@@ -0,0 +1,53 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Stand-in for the EXTI set-up: every pin can have an edge interrupt
+// (unless the test says otherwise), and the test passes the edges to the
+// debouncer itself
+
+#include <stdint.h>
+
+#include "cmsis.h"
+#include "EdgeCapture.h"
+#include "EdgeCaptureStub.h"
+
+static bool available = true;
+
+void SetStubEdgeCaptureAvailable(bool is_available)
+{
+	available = is_available;
+}
+
+bool EnableEdgeCapture(GPIO_TypeDef *port, uint8_t pin)
+{
+	(void) port;
+	(void) pin;
+	return available;
+}
+
+bool GetNextEdge(Edge *edge)
+{
+	(void) edge;
+	return false;
+}
+
+uint32_t GetEdgeOverflowCount()
+{
+	return 0U;
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Fake clock for host tests: replaces Clock.cpp's counters with a
+// single microsecond count that the test advances by hand
+
+#include <stdint.h>
+
+#include "Clock.h"
+#include "FakeClock.h"
+
+static uint64_t fake_us = 0U;
+
+void SetFakeMicroseconds(uint64_t us)
+{
+	fake_us = us;
+}
+
+void AdvanceFakeMicroseconds(uint64_t us)
+{
+	fake_us += us;
+}
+
+void AdvanceFakeMilliseconds(uint32_t ms)
+{
+	fake_us += ((uint64_t) ms) * 1000U;
+}
+
+uint64_t GetFakeMicroseconds(void)
+{
+	return fake_us;
+}
+
+uint64_t GetMicrosecondCounter(void)
+{
+	return fake_us;
+}
+
+// The firmware's millisecond counter is the low 32 bits of the
+// millisecond count, so it wraps every 49.7 days
+uint32_t GetMillisecondCounter(void)
+{
+	return (uint32_t) (fake_us / 1000U);
+}
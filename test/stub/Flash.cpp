@@ -0,0 +1,122 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Stand-in for the flash driver: the persistent data sectors are
+// emulated in memory.  Programming can only clear bits, as on the real
+// flash.  When the power is cut, the operation in progress is left
+// half done (a random selection of words erased or bits cleared) and
+// StubPowerCut is thrown.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <assert.h>
+
+#include "Flash.h"
+#include "FlashStub.h"
+
+#define FIRST_SECTOR STORE_FLASH_SECTOR_A
+#define SECTOR_COUNT 3
+#define FIRST_ADDRESS STORE_FLASH_ADDRESS_A
+#define SECTOR_WORDS (FLASH_SECTOR_SIZE / 4U)
+
+static uint32_t sectors[SECTOR_COUNT][SECTOR_WORDS];
+static int32_t operations_left = -1;
+static uint32_t erase_count = 0U;
+static uint32_t program_count = 0U;
+
+static uint32_t *Word(uint32_t address)
+{
+	uint32_t offset = address - FIRST_ADDRESS;
+	assert(((offset % 4U) == 0U) && (offset < (SECTOR_COUNT * FLASH_SECTOR_SIZE)));
+	return &sectors[offset / FLASH_SECTOR_SIZE][(offset % FLASH_SECTOR_SIZE) / 4U];
+}
+
+// True if the power fails during this operation
+static bool PowerCut()
+{
+	if (operations_left == 0) {
+		operations_left = -1;
+		return true;
+	}
+	if (operations_left > 0) {
+		operations_left--;
+	}
+	return false;
+}
+
+void ClearStubFlash(void)
+{
+	for (int s=0;s<SECTOR_COUNT;s++) {
+		for (uint32_t i=0U;i<SECTOR_WORDS;i++) {
+			sectors[s][i] = FLASH_ERASED_WORD;
+		}
+	}
+}
+
+void SetStubFlashPowerCut(int32_t operations)
+{
+	operations_left = operations;
+}
+
+uint32_t GetStubFlashEraseCount(void)
+{
+	return erase_count;
+}
+
+uint32_t GetStubFlashProgramCount(void)
+{
+	return program_count;
+}
+
+bool EraseFlashSector(uint8_t sector)
+{
+	assert((sector >= FIRST_SECTOR) && (sector < (FIRST_SECTOR + SECTOR_COUNT)));
+	uint32_t *words = sectors[sector - FIRST_SECTOR];
+	bool cut = PowerCut();
+
+	erase_count++;
+	for (uint32_t i=0U;i<SECTOR_WORDS;i++) {
+		if (( ! cut) || ((rand() & 1) != 0)) {
+			words[i] = FLASH_ERASED_WORD;
+		}
+	}
+	if (cut) {
+		throw StubPowerCut();
+	}
+	return true;
+}
+
+bool ProgramFlashWord(uint32_t address, uint32_t data)
+{
+	bool cut = PowerCut();
+
+	program_count++;
+	if (cut) {
+		// Torn write: only some of the bits are cleared
+		*Word(address) &= (data | (uint32_t) rand());
+		throw StubPowerCut();
+	}
+	*Word(address) &= data;
+	return (*Word(address) == data);
+}
+
+uint32_t ReadFlashWord(uint32_t address)
+{
+	return *Word(address);
+}
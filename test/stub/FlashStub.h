@@ -0,0 +1,38 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Controls for the emulated flash
+
+#ifndef FLASHSTUB_H
+#define FLASHSTUB_H
+
+#include <stdint.h>
+
+// Thrown by the flash functions when the emulated power fails
+struct StubPowerCut {};
+
+// Erase all the emulated sectors
+void ClearStubFlash(void);
+// Cut the power (part way through) the given flash operation from now;
+// negative for never
+void SetStubFlashPowerCut(int32_t operations);
+uint32_t GetStubFlashEraseCount(void);
+uint32_t GetStubFlashProgramCount(void);
+
+#endif
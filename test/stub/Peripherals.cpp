@@ -0,0 +1,47 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Host memory in place of the peripheral registers
+
+#include <stdint.h>
+#include <sys/mman.h>
+
+#include "cmsis.h"
+#include "Peripherals.h"
+
+// GPIOA to GPIOH, rounded out to whole pages
+#define GPIO_MAP_START (GPIOA_BASE & ~((uintptr_t) 0xFFFU))
+#define GPIO_MAP_LENGTH ((size_t) 0x2000U)
+
+#define PAGE_MASK ((uintptr_t) 0xFFFU)
+
+bool MapRegisters(uintptr_t base, size_t length)
+{
+	uintptr_t start = base & ~PAGE_MASK;
+	size_t pages_length = (size_t) (((base + length + PAGE_MASK) & ~PAGE_MASK) - start);
+	void *address = mmap((void *) start, pages_length,
+			PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE,
+			-1, 0);
+	return address == ((void *) start);
+}
+
+bool MapGpioPorts()
+{
+	return MapRegisters(GPIO_MAP_START, GPIO_MAP_LENGTH);
+}
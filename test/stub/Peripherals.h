@@ -0,0 +1,37 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Host memory in place of the peripheral registers, so that code which
+// reads and writes them directly (including the Pin templates in
+// Pins.h) can run in a test
+
+#ifndef PERIPHERALS_H
+#define PERIPHERALS_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Map the GPIO register block at its STM32 address (all zero to start
+// with).  Returns false if the address range isn't free on this host.
+bool MapGpioPorts();
+// Map the whole pages covering a register block (e.g. TIM2_BASE or
+// SCS_BASE for the NVIC and SCB), all zero to start with
+bool MapRegisters(uintptr_t base, size_t length);
+
+#endif
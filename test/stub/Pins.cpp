@@ -0,0 +1,82 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Stand-in for the GPIO functions in Pins.cpp: input levels are set by
+// the test and everything else does nothing
+
+#include <stdint.h>
+
+#include "cmsis.h"
+#include "Pins.h"
+#include "PinsStub.h"
+
+#define STUB_PORT_COUNT 3
+
+static bool levels[STUB_PORT_COUNT][16];
+
+static int PortIndex(GPIO_TypeDef *port)
+{
+	if (port == GPIOA) {
+		return 0;
+	}
+	else if (port == GPIOB) {
+		return 1;
+	}
+	return 2;
+}
+
+void SetStubPinLevel(GPIO_TypeDef *port, uint8_t pin, bool high)
+{
+	levels[PortIndex(port)][pin & 0xFU] = high;
+}
+
+bool GetPinState(GPIO_TypeDef *port, uint8_t pin)
+{
+	return levels[PortIndex(port)][pin & 0xFU];
+}
+
+void SetPinState(GPIO_TypeDef *port, uint8_t pin, bool high)
+{
+	SetStubPinLevel(port, pin, high);
+}
+
+void SetPinAsInputFloat(GPIO_TypeDef *port, uint8_t pin)
+{
+	(void) port;
+	(void) pin;
+}
+
+void SetPinAsInputPullUp(GPIO_TypeDef *port, uint8_t pin)
+{
+	(void) port;
+	(void) pin;
+}
+
+void SetPinAsGPO_PP(GPIO_TypeDef *port, uint8_t pin)
+{
+	(void) port;
+	(void) pin;
+}
+
+void SetPinAsAFO_PP(GPIO_TypeDef *port, uint8_t pin, uint8_t afnum)
+{
+	(void) port;
+	(void) pin;
+	(void) afnum;
+}
@@ -0,0 +1,31 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Controls for the stand-in GPIO functions
+
+#ifndef PINSSTUB_H
+#define PINSSTUB_H
+
+#include <stdint.h>
+#include "cmsis.h"
+
+// Only ports A, B and C are kept apart
+void SetStubPinLevel(GPIO_TypeDef *port, uint8_t pin, bool high);
+
+#endif
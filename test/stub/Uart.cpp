@@ -0,0 +1,114 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Stand-in for the UART driver: the buffers are real, and each update
+// takes a millisecond of fake time and "transmits" a set number of bytes
+// (none by default, so tests can read the output from the buffer)
+
+#include <stdint.h>
+
+#include "CircularBuffer.h"
+#include "Uart.h"
+#include "FakeClock.h"
+#include "UartStub.h"
+
+static CircularBuffer outgoing;
+static CircularBuffer incoming;
+
+static uint16_t bytes_per_update = 0U;
+static uint32_t update_count = 0U;
+
+void SetStubUartBytesPerUpdate(uint16_t bytes)
+{
+	bytes_per_update = bytes;
+}
+
+uint32_t GetStubUartUpdateCount(void)
+{
+	return update_count;
+}
+
+void Uart::Init()
+{
+	outgoingBuffer = &outgoing;
+	incomingBuffer = &incoming;
+	outgoingBuffer->clear();
+	incomingBuffer->clear();
+	outgoingBuffer->setOverflowPolicy(OverflowDropNewest);
+	incomingBuffer->setOverflowPolicy(OverflowBlock);
+	baudRate = DEFAULT_BAUD_RATE;
+	requestedBaudRate = 0U;
+	requestTimer = 0U;
+	awaitingConfirmation = false;
+	confirmationTimer = 0U;
+}
+
+void Uart::Update(void)
+{
+	for (uint16_t i=0;(i<bytes_per_update) && outgoingBuffer->containsData();i++) {
+		(void) outgoingBuffer->getEntry();
+	}
+	update_count++;
+	AdvanceFakeMilliseconds(1U);
+}
+
+bool Uart::RequestBaudRate(uint32_t baud)
+{
+	(void) baud;
+	return false;
+}
+
+void Uart::ConfirmBaudRate(void)
+{
+}
+
+uint32_t Uart::GetBaudRate(void)
+{
+	return baudRate;
+}
+
+bool Uart::IsTransmitIdle(void)
+{
+	return outgoingBuffer->isEmpty();
+}
+
+bool Uart::IsIdle(void)
+{
+	return IsTransmitIdle() && ( ! incomingBuffer->containsData());
+}
+
+uint16_t Uart::GetIsrRxHighWaterMark(void)
+{
+	return 0U;
+}
+
+uint16_t Uart::GetIsrTxHighWaterMark(void)
+{
+	return 0U;
+}
+
+uint32_t Uart::GetIsrRxOverrunCount(void)
+{
+	return 0U;
+}
+
+void Uart::SetBaudRate(uint32_t baud)
+{
+	baudRate = baud;
+}
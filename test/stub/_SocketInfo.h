@@ -0,0 +1,12 @@
+// Stand-in for the socket information that compile.py generates for a
+// firmware build
+#define SOCKET_NAME "Test #1"
+#define SOCKET_BASE_PATTERN 0x08A20A0U
+#define SOCKET_UNIT_CODE 0x8U
+#define SOCKET_ON_PATTERN 0x10U
+#define SOCKET_OFF_PATTERN 0x0U
+#define SOCKET_PATTERN_LENGTH 25U
+#define SOCKET_BIT_PERIOD 1076U
+#define CHANGESET "host"
+#define BUILD_DATE "host"
+#define VERSION "host"
@@ -0,0 +1,2 @@
+// Stand-in for the mbed target's device.h
+#define DEVICE_FLASH 1
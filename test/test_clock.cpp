@@ -0,0 +1,111 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: the time helpers in Clock.h work across the counters wrapping
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Clock.h"
+#include "FakeClock.h"
+#include "Check.h"
+
+// Microsecond time at which the 32-bit millisecond counter wraps
+#define MILLISECOND_WRAP_US (((uint64_t) 1U << 32) * 1000U)
+
+static void TestMillisecondWrap()
+{
+	SetFakeMicroseconds(MILLISECOND_WRAP_US - 15000U);
+	uint32_t start = GetMillisecondCounter();
+	CHECK_EQUAL(0xFFFFFFF1U, start);
+
+	AdvanceFakeMilliseconds(14U);
+	CHECK_EQUAL(14U, ElapsedMilliseconds(start));
+	CHECK( ! MillisecondsHaveElapsed(start, 20U));
+
+	// Counter wraps to zero
+	AdvanceFakeMilliseconds(1U);
+	CHECK_EQUAL(0U, GetMillisecondCounter());
+	CHECK_EQUAL(15U, ElapsedMilliseconds(start));
+	CHECK( ! MillisecondsHaveElapsed(start, 20U));
+
+	AdvanceFakeMilliseconds(4U);
+	CHECK( ! MillisecondsHaveElapsed(start, 20U));
+	AdvanceFakeMilliseconds(1U);
+	CHECK(MillisecondsHaveElapsed(start, 20U));
+	CHECK_EQUAL(20U, ElapsedMilliseconds(start));
+
+	// The 64-bit helpers don't notice the 32-bit wrap
+	SetFakeMicroseconds(MILLISECOND_WRAP_US - 500U);
+	Timestamp t = GetTimestamp();
+	Deadline d = DeadlineAfter(Milliseconds(2));
+	AdvanceFakeMicroseconds(1000U);
+	CHECK_EQUAL(1000U, TimeSince(t).us);
+	CHECK( ! DeadlineHasPassed(d));
+	CHECK_EQUAL(1000U, TimeUntil(d).us);
+	AdvanceFakeMicroseconds(1000U);
+	CHECK(DeadlineHasPassed(d));
+}
+
+static void TestMicrosecondWrap()
+{
+	// Nothing runs for 584,000 years, but the arithmetic should still be
+	// right if the counter does wrap
+	SetFakeMicroseconds(UINT64_MAX - 499U);
+	Timestamp t = GetTimestamp();
+	Deadline d = DeadlineAfter(Microseconds(1000));
+	CHECK_EQUAL(500U, d.us);
+	CHECK( ! DeadlineHasPassed(d));
+	CHECK_EQUAL(1000U, TimeUntil(d).us);
+
+	AdvanceFakeMicroseconds(500U);
+	CHECK_EQUAL(0U, GetMicrosecondCounter());
+	CHECK_EQUAL(500U, TimeSince(t).us);
+	CHECK( ! DeadlineHasPassed(d));
+	CHECK_EQUAL(500U, TimeUntil(d).us);
+
+	AdvanceFakeMicroseconds(499U);
+	CHECK( ! DeadlineHasPassed(d));
+	CHECK_EQUAL(1U, TimeUntil(d).us);
+
+	AdvanceFakeMicroseconds(1U);
+	CHECK(DeadlineHasPassed(d));
+	CHECK_EQUAL(0U, TimeUntil(d).us);
+
+	// A deadline that has passed gives a negative time until it
+	AdvanceFakeMicroseconds(250U);
+	CHECK(DeadlineHasPassed(d));
+	CHECK(TimeUntil(d).us == -250);
+	CHECK_EQUAL(1250U, TimeSince(t).us);
+
+	// Deadlines relative to a timestamp from before the wrap
+	Deadline from = DeadlineFrom(t, Milliseconds(2));
+	CHECK( ! DeadlineHasPassed(from));
+	CHECK_EQUAL(1U, DurationInMilliseconds(TimeSince(t)));
+	AdvanceFakeMicroseconds(750U);
+	CHECK(DeadlineHasPassed(from));
+	CHECK_EQUAL(2U, DurationInMilliseconds(TimeSince(t)));
+}
+
+int main()
+{
+	TestMillisecondWrap();
+	TestMicrosecondWrap();
+	return CHECK_RESULT();
+}
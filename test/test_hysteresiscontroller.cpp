@@ -0,0 +1,221 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: the controller's transition table, with the time and current
+// passed in.  Two instances with different parameters run side by side
+// (one of them across the millisecond counter wrapping) to check that
+// they're independent.
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "HysteresisController.h"
+#include "Check.h"
+
+#define RUN_MS 9000U
+#define MAX_TRANSITIONS 16
+
+typedef struct {
+	uint32_t t;       // Milliseconds from the start of the run
+	ControllerState state;
+	ControllerOutput output;
+} Transition;
+
+typedef struct {
+	HysteresisController controller;
+	uint32_t base_ms;
+	Transition seen[MAX_TRANSITIONS];
+	int seen_count;
+} Instance;
+
+// Current (and detected starts) for each instance over the run
+typedef uint16_t (*CurrentProfile)(uint32_t t);
+typedef bool (*StartProfile)(uint32_t t);
+
+static uint16_t CurrentA(uint32_t t)
+{
+	if ((t >= 100U) && (t < 1500U)) {
+		return 200U;
+	}
+	if ((t >= 3000U) && (t < 3010U)) {
+		// Above the low threshold only: cancels the run-on
+		return 60U;
+	}
+	return 10U;
+}
+
+static uint16_t CurrentB(uint32_t t)
+{
+	if ((t >= 200U) && (t < 4000U)) {
+		return 100U;
+	}
+	if ((t >= 5000U) && (t < 5100U)) {
+		// Between the thresholds while idle: stays off
+		return 80U;
+	}
+	return 0U;
+}
+
+static uint16_t CurrentPredicted(uint32_t t)
+{
+	return ((t >= 150U) && (t < 1000U)) ? 200U : 10U;
+}
+
+static bool StartAt100(uint32_t t)
+{
+	return t == 100U;
+}
+
+// A detected start that the average never confirms, then a real run
+// that starts while the withdrawn start is still being turned off
+static uint16_t CurrentUnconfirmed(uint32_t t)
+{
+	return ((t >= 1000U) && (t < 2000U)) ? 200U : 10U;
+}
+
+static bool NoStart(uint32_t t)
+{
+	(void) t;
+	return false;
+}
+
+// Record state changes and the transmitter commands
+static void Run(Instance *instances[], const CurrentProfile currents[],
+		const StartProfile starts[], int count)
+{
+	for (uint32_t t=0;t<RUN_MS;t++) {
+		for (int i=0;i<count;i++) {
+			Instance *in = instances[i];
+			ControllerState before = in->controller.GetState();
+			ControllerOutput output = in->controller.Update(in->base_ms + t,
+					currents[i](t), starts[i](t));
+			ControllerState after = in->controller.GetState();
+			if ((after != before) || (output == OutputTransmitOn) || (output == OutputTransmitOff)) {
+				if (in->seen_count < MAX_TRANSITIONS) {
+					in->seen[in->seen_count] = {t, after, output};
+				}
+				in->seen_count++;
+			}
+		}
+	}
+}
+
+static void CheckTransitions(const Instance *in, const Transition *expected, int count)
+{
+	CHECK_EQUAL(count, in->seen_count);
+	for (int i=0;(i<count) && (i<in->seen_count);i++) {
+		CHECK_EQUAL(expected[i].t, in->seen[i].t);
+		CHECK_EQUAL(expected[i].state, in->seen[i].state);
+		CHECK_EQUAL(expected[i].output, in->seen[i].output);
+	}
+}
+
+static void TestTwoInstances()
+{
+	HysteresisParameters parameters_a = {70U, 50U, 2000U, 2000U, 500U};
+	HysteresisParameters parameters_b = {90U, 60U, 500U, 300U, 500U};
+	Instance a;
+	Instance b;
+	a.controller.Init(&parameters_a);
+	a.base_ms = 0U;
+	a.seen_count = 0;
+	b.controller.Init(&parameters_b);
+	// The millisecond counter wraps during B's run-on
+	b.base_ms = 0xFFFFFFFFU - 4200U;
+	b.seen_count = 0;
+
+	Instance *instances[] = {&a, &b};
+	const CurrentProfile currents[] = {CurrentA, CurrentB};
+	const StartProfile starts[] = {NoStart, NoStart};
+	Run(instances, currents, starts, 2);
+
+	static const Transition expected_a[] = {
+		{100U,  TurningOnState,  OutputTransmitOn},
+		{1500U, DelayState,      OutputNone},
+		{3000U, TurningOnState,  OutputNone},
+		{3010U, DelayState,      OutputNone},
+		{5010U, TurningOffState, OutputTransmitOff},
+		{7010U, IdleState,       OutputStop},
+	};
+	static const Transition expected_b[] = {
+		{200U,  TurningOnState,  OutputTransmitOn},
+		{4000U, DelayState,      OutputNone},
+		{4500U, TurningOffState, OutputTransmitOff},
+		{4800U, IdleState,       OutputStop},
+	};
+	CheckTransitions(&a, expected_a, (int) (sizeof(expected_a) / sizeof(expected_a[0])));
+	CheckTransitions(&b, expected_b, (int) (sizeof(expected_b) / sizeof(expected_b[0])));
+}
+
+static void TestConfirmedStart()
+{
+	HysteresisParameters parameters = {70U, 50U, 2000U, 2000U, 500U};
+	Instance c;
+	c.controller.Init(&parameters);
+	c.base_ms = 0U;
+	c.seen_count = 0;
+
+	Instance *instances[] = {&c};
+	const CurrentProfile currents[] = {CurrentPredicted};
+	const StartProfile starts[] = {StartAt100};
+	Run(instances, currents, starts, 1);
+
+	// Turned on by the detected start and confirmed by the current
+	static const Transition expected[] = {
+		{100U,  PredictedOnState, OutputTransmitOn},
+		{150U,  TurningOnState,   OutputNone},
+		{1000U, DelayState,       OutputNone},
+		{3000U, TurningOffState,  OutputTransmitOff},
+		{5000U, IdleState,        OutputStop},
+	};
+	CheckTransitions(&c, expected, (int) (sizeof(expected) / sizeof(expected[0])));
+}
+
+static void TestUnconfirmedStart()
+{
+	HysteresisParameters parameters = {70U, 50U, 2000U, 2000U, 500U};
+	Instance d;
+	d.controller.Init(&parameters);
+	d.base_ms = 0U;
+	d.seen_count = 0;
+
+	Instance *instances[] = {&d};
+	const CurrentProfile currents[] = {CurrentUnconfirmed};
+	const StartProfile starts[] = {StartAt100};
+	Run(instances, currents, starts, 1);
+
+	// The socket may have turned on, so the withdrawal sends "turn off"
+	static const Transition expected[] = {
+		{100U,  PredictedOnState, OutputTransmitOn},
+		{600U,  TurningOffState,  OutputTransmitOff},
+		{1000U, TurningOnState,   OutputTransmitOn},
+		{2000U, DelayState,       OutputNone},
+		{4000U, TurningOffState,  OutputTransmitOff},
+		{6000U, IdleState,        OutputStop},
+	};
+	CheckTransitions(&d, expected, (int) (sizeof(expected) / sizeof(expected[0])));
+}
+
+int main()
+{
+	TestTwoInstances();
+	TestConfirmedStart();
+	TestUnconfirmedStart();
+	return CHECK_RESULT();
+}
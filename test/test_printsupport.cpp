@@ -0,0 +1,93 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: blocking output waits for at most the timeout per message
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "CircularBuffer.h"
+#include "PrintSupport.h"
+#include "tinyprintf.h"
+#include "FakeClock.h"
+#include "UartStub.h"
+#include "Check.h"
+
+// Matches BLOCK_TIMEOUT_MS in PrintSupport.cpp
+#define TIMEOUT_MS 20U
+
+#define MESSAGE "0123456789012345678901234567890123456789" \
+	"0123456789012345678901234567890123456789"
+
+static CircularBuffer *outgoing;
+
+static void FillOutgoingBuffer()
+{
+	outgoing->clear();
+	while ( ! outgoing->isFull()) {
+		outgoing->addEntry((DTYPE) 'x');
+	}
+}
+
+// Time taken by a message that's sent a character at a time
+static uint64_t TimePrintf()
+{
+	uint64_t start = GetFakeMicroseconds();
+	tfp_printf("%s", MESSAGE);
+	return (GetFakeMicroseconds() - start) / 1000U;
+}
+
+static uint64_t TimeBufprintf()
+{
+	uint64_t start = GetFakeMicroseconds();
+	bufprintf("%s", MESSAGE);
+	return (GetFakeMicroseconds() - start) / 1000U;
+}
+
+int main()
+{
+	InitPrintSupport();
+	outgoing = GetStreamBuffer(OutgoingStream);
+	outgoing->setOverflowPolicy(OverflowBlock);
+
+	// Stalled UART: each message gives up after one timeout, rather than
+	// one timeout per character
+	SetStubUartBytesPerUpdate(0U);
+	FillOutgoingBuffer();
+	CHECK(TimePrintf() <= TIMEOUT_MS);
+	CHECK(TimePrintf() == 0U);
+	UpdatePrintSupport();
+	CHECK(TimePrintf() >= TIMEOUT_MS);
+	CHECK(TimeBufprintf() <= TIMEOUT_MS);
+	putstring(MESSAGE);
+	CHECK(TimePrintf() == 0U);
+
+	// Working UART: the messages wait for space and nothing is dropped
+	SetStubUartBytesPerUpdate(12U);
+	FillOutgoingBuffer();
+	uint32_t drops = outgoing->getDropCount();
+	UpdatePrintSupport();
+	TimePrintf();
+	UpdatePrintSupport();
+	TimeBufprintf();
+	CHECK_EQUAL(drops, outgoing->getDropCount());
+
+	return CHECK_RESULT();
+}
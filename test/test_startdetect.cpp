@@ -0,0 +1,148 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: start detection over 2000 synthetic traces of each kind, with
+// the controller turned on by the 64 sample average alone and then with
+// predictive start.  Motor starts must all be caught and predictive
+// start must be much quicker; any predicted start that the average
+// doesn't confirm must be withdrawn with "turn off".
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+
+#include "HysteresisController.h"
+#include "StartDetector.h"
+#include "CurrentTraces.h"
+#include "Check.h"
+
+#define TRACES 2000
+#define TRACE_MS 1500
+#define EVENT_MS 300
+
+// As the firmware's averaging (Analogue.cpp)
+#define SUM_SHIFT 6
+#define NUM_SAMPLES (1 << SUM_SHIFT)
+
+typedef struct {
+	int latency_ms;       // From the event to "turn on" (-1 if never)
+	bool withdrawn;       // Predicted on, then sent "turn off"
+	bool left_on;         // Predicted on and never turned off
+} TraceResult;
+
+static TraceResult RunTrace(const uint16_t *samples, bool predictive)
+{
+	HysteresisParameters controller_parameters = {70U, 50U, 2000U, 2000U, 250U};
+	StartDetectorParameters detector_parameters = {70U, 40U, 50U};
+	HysteresisController controller;
+	StartDetector detector;
+	uint16_t history[NUM_SAMPLES] = {0U};
+	uint32_t sum = 0U;
+	bool predicted = false;
+	TraceResult result = {-1, false, false};
+
+	controller.Init(&controller_parameters);
+	detector.Init(&detector_parameters);
+
+	for (int t=0;t<TRACE_MS;t++) {
+		sum -= history[t % NUM_SAMPLES];
+		history[t % NUM_SAMPLES] = samples[t];
+		sum += samples[t];
+		uint16_t average = (t >= NUM_SAMPLES) ? (uint16_t) (sum >> SUM_SHIFT) : 0U;
+		bool detected = detector.AddSample(samples[t]);
+
+		ControllerOutput output = controller.Update((uint32_t) t, average, predictive && detected);
+		if (controller.GetState() == PredictedOnState) {
+			predicted = true;
+		}
+		if ((output == OutputTransmitOn) && (result.latency_ms < 0)) {
+			result.latency_ms = t - EVENT_MS;
+		}
+		if (predicted && (output == OutputTransmitOff)) {
+			result.withdrawn = true;
+		}
+	}
+	result.left_on = predicted && ( ! result.withdrawn)
+		&& (controller.GetState() == IdleState);
+	return result;
+}
+
+static void RunKind(TraceKind kind, bool predictive, TraceResult *results)
+{
+	uint16_t samples[TRACE_MS];
+	for (int i=0;i<TRACES;i++) {
+		MakeCurrentTrace(kind, samples, TRACE_MS, EVENT_MS);
+		results[i] = RunTrace(samples, predictive);
+	}
+}
+
+static TraceResult results[TRACES];
+static int latencies[TRACES];
+
+int main()
+{
+	int p90[2] = {0, 0};
+
+	for (int predictive=0;predictive<2;predictive++) {
+		srand(3);
+		RunKind(MotorStartTrace, predictive != 0, results);
+
+		int missed = 0;
+		for (int i=0;i<TRACES;i++) {
+			latencies[i] = results[i].latency_ms;
+			if (latencies[i] < 0) {
+				missed++;
+			}
+		}
+		std::sort(latencies, latencies + TRACES);
+		int caught = TRACES - missed;
+		int *l = &latencies[missed];
+		if (caught > 0) {
+			p90[predictive] = l[(caught * 9) / 10];
+			fprintf(stderr, "%s: motor start latency ms p50 %d p90 %d p99 %d max %d (missed %d/%d)\n",
+					(predictive != 0) ? "predictive" : "average   ",
+					l[caught / 2], l[(caught * 9) / 10], l[(caught * 99) / 100], l[caught - 1],
+					missed, TRACES);
+		}
+		CHECK_EQUAL(0, missed);
+
+		for (int k=((int) MotorStartTrace)+1;k<TRACE_KIND_COUNT;k++) {
+			RunKind((TraceKind) k, predictive != 0, results);
+			int turned_on = 0;
+			int withdrawn = 0;
+			int left_on = 0;
+			for (int i=0;i<TRACES;i++) {
+				turned_on += (results[i].latency_ms >= 0) ? 1 : 0;
+				withdrawn += results[i].withdrawn ? 1 : 0;
+				left_on += results[i].left_on ? 1 : 0;
+			}
+			fprintf(stderr, "    %-18s turned on %d/%d, predicted and withdrawn %d\n",
+					GetTraceKindName((TraceKind) k), turned_on, TRACES, withdrawn);
+			CHECK_EQUAL(0, left_on);
+			if (k != (int) BurstTrace) {
+				// Too short or too small to reach the average's threshold
+				CHECK_EQUAL(0, turned_on);
+			}
+		}
+	}
+	CHECK(p90[1] < (p90[0] / 2));
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,155 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: persistent store with the power cut at a random flash operation
+// (part way through a write, a compaction or an erase) thousands of
+// times.  After each restart, every key must have either the value it
+// had when the store was last idle or one written since then, and a
+// key that was never written must still be missing.  The spare sector
+// must only be erased while the application is idle.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "Store.h"
+#include "FlashStub.h"
+#include "Check.h"
+
+#define RUNS 10000
+#define STEPS_PER_RUN 2000
+#define MAX_OPERATIONS_BEFORE_CUT 1000
+// Some settings and usage counters
+#define KEYS 40U
+
+// The store only erases while the application is idle
+static bool application_idle = true;
+
+bool IsApplicationIdle()
+{
+	return application_idle;
+}
+
+bool IsPrintSupportIdle()
+{
+	return true;
+}
+
+// The value of each key when the store was last idle, and any written
+// since then (any of which may have reached flash)
+static bool durable_present[KEYS];
+static uint32_t durable[KEYS];
+static std::vector<uint32_t> written[KEYS];
+
+static void RecordIdle()
+{
+	for (uint16_t key=0U;key<KEYS;key++) {
+		if ( ! written[key].empty()) {
+			durable_present[key] = true;
+			durable[key] = written[key].back();
+			written[key].clear();
+		}
+	}
+}
+
+static bool ValueAllowed(uint16_t key, bool present, uint32_t value)
+{
+	if ( ! present) {
+		return ! durable_present[key];
+	}
+	if (durable_present[key] && (value == durable[key])) {
+		return true;
+	}
+	for (uint32_t w : written[key]) {
+		if (w == value) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int main()
+{
+	uint32_t cuts = 0U;
+	uint32_t failures = 0U;
+	uint32_t max_generation = 0U;
+	uint32_t busy_erases = 0U;
+
+	srand(1);
+	ClearStubFlash();
+	InitStore();
+
+	for (int run=0;run<RUNS;run++) {
+		SetStubFlashPowerCut(rand() % MAX_OPERATIONS_BEFORE_CUT);
+		try {
+			for (int step=0;step<STEPS_PER_RUN;step++) {
+				if ((rand() % 4) == 0) {
+					uint16_t key = (uint16_t) (rand() % KEYS);
+					uint32_t value = (uint32_t) (rand() % 1000);
+					CHECK(WriteStoreValue(key, value));
+					written[key].push_back(value);
+				}
+				application_idle = ((rand() % 50) == 0);
+				uint32_t erases = GetStubFlashEraseCount();
+				UpdateStore();
+				if (( ! application_idle) && (GetStubFlashEraseCount() != erases)) {
+					busy_erases++;
+				}
+				if (IsStoreIdle()) {
+					RecordIdle();
+				}
+			}
+		}
+		catch (StubPowerCut &) {
+			cuts++;
+		}
+		SetStubFlashPowerCut(-1);
+
+		InitStore();
+		for (uint16_t key=0U;key<KEYS;key++) {
+			uint32_t value = 0U;
+			bool present = ReadStoreValue(key, &value);
+			if ( ! ValueAllowed(key, present, value)) {
+				if (failures < 10U) {
+					fprintf(stderr, "run %d: key %u %s %u\n", run, key,
+							present ? "has unexpected value" : "lost; was", present ? value : durable[key]);
+				}
+				failures++;
+			}
+			// Whatever survived is now the durable value
+			durable_present[key] = present;
+			durable[key] = value;
+			written[key].clear();
+		}
+		if (GetStoreStatistics()->generation > max_generation) {
+			max_generation = GetStoreStatistics()->generation;
+		}
+	}
+
+	fprintf(stderr, "runs %d power cuts %u generation %u erases %u words programmed %u\n",
+			RUNS, cuts, max_generation, GetStubFlashEraseCount(), GetStubFlashProgramCount());
+	CHECK_EQUAL(0U, failures);
+	// Erasing stalls the main loop, so it must wait until it's idle
+	CHECK_EQUAL(0U, busy_erases);
+	// Make sure the cuts land in compactions as well as writes
+	CHECK(max_generation > 100U);
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,161 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: 200 bouncing presses and releases of an edge interrupt input,
+// each preceded by a one millisecond glitch that must be ignored
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cmsis.h"
+#include "Clock.h"
+#include "Timers.h"
+#include "SwitchDebounce.h"
+#include "FakeClock.h"
+#include "PinsStub.h"
+#include "Check.h"
+
+#define PORT GPIOB
+#define PIN 3U
+
+#define PRESSES 200
+#define MAX_BOUNCE_MS 3
+#define HOLD_MS 150
+#define IDLE_MS 200
+#define GLITCH_BEFORE_MS 100
+#define CYCLE_MS 600
+// Matches EDGE_SETTLE_MS in SwitchDebounce.cpp
+#define SETTLE_MS 5
+// Latest that a change may be accepted after the first edge: the bounce,
+// the settling time and the update that sees the settle timer expire
+#define MAX_LATENCY_MS (MAX_BOUNCE_MS + SETTLE_MS + 1)
+
+static SwitchDebounce debouncer;
+static bool level = true;
+// Time of the first edge of the press or release in progress
+static uint64_t first_edge_us;
+static bool seen_edge = false;
+
+// The switch pulls the input low when pressed
+static void SetLevel(bool high)
+{
+	if (high != level) {
+		level = high;
+		SetStubPinLevel(PORT, PIN, high);
+		debouncer.HandleEdge(GetTimestamp());
+		if ( ! seen_edge) {
+			seen_edge = true;
+			first_edge_us = GetFakeMicroseconds();
+		}
+	}
+}
+
+static void Tick()
+{
+	AdvanceFakeMilliseconds(1U);
+	UpdateTimers();
+	debouncer.Update();
+}
+
+int main()
+{
+	int presses = 0;
+	int releases = 0;
+	int glitches = 0;
+	int worst_press_latency = 0;
+	int worst_release_latency = 0;
+	int wrong_change_times = 0;
+
+	srand(1);
+	SetFakeMicroseconds(1000000U);
+	SetStubPinLevel(PORT, PIN, true);
+	InitTimers();
+	CHECK(debouncer.Init(PORT, PIN, PushButtonDebounceTimer));
+	for (int t=0;t<(SETTLE_MS + 1);t++) {
+		Tick();
+	}
+	CHECK(debouncer.IsInitialised());
+	CHECK(debouncer.GetState());
+
+	bool last_state = true;
+	for (int cycle=0;cycle<PRESSES;cycle++) {
+		int bounce = rand() % (MAX_BOUNCE_MS + 1);
+		for (int t=0;t<CYCLE_MS;t++) {
+			int since_press = t - IDLE_MS;
+			int since_release = since_press - HOLD_MS;
+			if ((since_press == 0) || (since_release == 0)) {
+				seen_edge = false;
+			}
+			if (since_press < 0) {
+				SetLevel(since_press != -GLITCH_BEFORE_MS);
+			}
+			else if (since_press < bounce) {
+				SetLevel((rand() & 1) != 0);
+			}
+			else if (since_release < 0) {
+				SetLevel(false);
+			}
+			else if (since_release < bounce) {
+				SetLevel((rand() & 1) != 0);
+			}
+			else {
+				SetLevel(true);
+			}
+			Tick();
+
+			bool state = debouncer.GetState();
+			if (state == last_state) {
+				continue;
+			}
+			last_state = state;
+			// The change time is the first edge of the press or release
+			if ((since_press >= 0) && (debouncer.GetChangeTime().us != first_edge_us)) {
+				wrong_change_times++;
+			}
+			if (since_press < 0) {
+				glitches++;
+			}
+			else if ( ! state) {
+				presses++;
+				if (since_press > worst_press_latency) {
+					worst_press_latency = since_press;
+				}
+			}
+			else {
+				releases++;
+				if (since_release > worst_release_latency) {
+					worst_release_latency = since_release;
+				}
+			}
+		}
+	}
+
+	fprintf(stderr, "presses %d/%d releases %d/%d glitches %d worst latency %d/%d ms\n",
+			presses, PRESSES, releases, PRESSES, glitches,
+			worst_press_latency, worst_release_latency);
+	CHECK_EQUAL(PRESSES, presses);
+	CHECK_EQUAL(PRESSES, releases);
+	CHECK_EQUAL(0, glitches);
+	CHECK(worst_press_latency <= MAX_LATENCY_MS);
+	CHECK(worst_release_latency <= MAX_LATENCY_MS);
+	CHECK_EQUAL(0, wrong_change_times);
+
+	return CHECK_RESULT();
+}
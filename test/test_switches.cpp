@@ -0,0 +1,176 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: the polled (port group) debounce in Switches.cpp, built with
+// -D POLLED_SWITCHES so that the push button doesn't use its edge
+// interrupt.  The port is read from host memory in place of GPIOA.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "cmsis.h"
+#include "Clock.h"
+#include "Timers.h"
+#include "Settings.h"
+#include "Switches.h"
+#include "DefinedPins.h"
+#include "FakeClock.h"
+#include "Peripherals.h"
+#include "Check.h"
+
+#define DEBOUNCE_MS 100U
+// Four samples in a row must differ before a change is accepted
+#define SAMPLE_PERIOD_MS (DEBOUNCE_MS / 4U)
+#define MIN_LATENCY_MS (3 * SAMPLE_PERIOD_MS)
+
+#define PRESSES 200
+#define MAX_BOUNCE_MS 3
+#define HOLD_MS 300
+#define IDLE_MS 300
+// Each cycle is lengthened by up to a sample period so that the presses
+// and releases happen at different points between the samples
+#define CYCLE_MS (IDLE_MS + HOLD_MS + IDLE_MS)
+// Low for two samples at most, so it must never be accepted
+#define GLITCH_MS (2 * SAMPLE_PERIOD_MS)
+#define MAX_LATENCY_MS ((int) (MAX_BOUNCE_MS + (4 * SAMPLE_PERIOD_MS)))
+
+uint32_t GetSetting(SettingName name)
+{
+	return (name == DebounceSetting) ? DEBOUNCE_MS : 0U;
+}
+
+// The button pulls the input low when pressed
+static void SetButton(bool pressed)
+{
+	if (pressed) {
+		PushButtonPin::Port()->IDR &= ~((uint32_t) 1U << PushButtonPin::PinNumber);
+	}
+	else {
+		PushButtonPin::Port()->IDR |= ((uint32_t) 1U << PushButtonPin::PinNumber);
+	}
+}
+
+static void Tick()
+{
+	AdvanceFakeMilliseconds(1U);
+	UpdateTimers();
+	UpdateSwitches();
+}
+
+int main()
+{
+	if ( ! MapGpioPorts()) {
+		fprintf(stderr, "can't map the GPIO registers on this host\n");
+		return 1;
+	}
+
+	SetFakeMicroseconds(1000000U);
+	SetButton(false);
+	InitTimers();
+	InitSwitches();
+	CHECK( ! GetSwitchState(PushButtonSwitch));
+
+	int presses = 0;
+	int releases = 0;
+	int glitches = 0;
+	int min_latency = HOLD_MS;
+	int max_latency = 0;
+	int wrong_change_times = 0;
+	bool last_state = false;
+
+	srand(3);
+	for (int cycle=0;cycle<PRESSES;cycle++) {
+		int bounce = rand() % (MAX_BOUNCE_MS + 1);
+		int length = CYCLE_MS + (rand() % SAMPLE_PERIOD_MS);
+		// Start the glitch at a random point relative to the samples
+		int glitch_start = (IDLE_MS / 2) - (rand() % SAMPLE_PERIOD_MS);
+		uint64_t press_us = 0U;
+		uint64_t release_us = 0U;
+
+		for (int t=0;t<length;t++) {
+			int since_press = t - IDLE_MS;
+			int since_release = since_press - HOLD_MS;
+			if (since_press < 0) {
+				SetButton((t >= glitch_start) && (t < (glitch_start + (int) GLITCH_MS)));
+			}
+			else if (since_press < bounce) {
+				SetButton((rand() & 1) != 0);
+			}
+			else if (since_release < 0) {
+				SetButton(true);
+			}
+			else if (since_release < bounce) {
+				SetButton((rand() & 1) != 0);
+			}
+			else {
+				SetButton(false);
+			}
+			if (since_press == 0) {
+				press_us = GetFakeMicroseconds();
+			}
+			if (since_release == 0) {
+				release_us = GetFakeMicroseconds();
+			}
+			Tick();
+
+			bool state = GetSwitchState(PushButtonSwitch);
+			if (state == last_state) {
+				continue;
+			}
+			last_state = state;
+
+			int latency = state ? since_press : since_release;
+			if (since_press < 0) {
+				glitches++;
+				continue;
+			}
+			if (state) {
+				presses++;
+			}
+			else {
+				releases++;
+			}
+			if (latency < min_latency) {
+				min_latency = latency;
+			}
+			if (latency > max_latency) {
+				max_latency = latency;
+			}
+			// The change time is the first sample that saw the change
+			uint64_t edge_us = state ? press_us : release_us;
+			uint64_t change_us = GetSwitchChangeTime(PushButtonSwitch).us;
+			if ((change_us < edge_us)
+					|| (change_us > (edge_us + ((MAX_BOUNCE_MS + SAMPLE_PERIOD_MS) * 1000U)))) {
+				wrong_change_times++;
+			}
+		}
+	}
+
+	fprintf(stderr, "presses %d/%d releases %d/%d glitches %d latency %d-%d ms\n",
+			presses, PRESSES, releases, PRESSES, glitches, min_latency, max_latency);
+	CHECK_EQUAL(PRESSES, presses);
+	CHECK_EQUAL(PRESSES, releases);
+	CHECK_EQUAL(0, glitches);
+	CHECK(min_latency >= (int) MIN_LATENCY_MS);
+	CHECK(max_latency <= MAX_LATENCY_MS);
+	CHECK_EQUAL(0, wrong_change_times);
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,134 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: the timer wheel against a simple model of each timer, with
+// random starts and stops (including long timers that have to be
+// re-filed) while the millisecond counter wraps
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "Clock.h"
+#include "Timers.h"
+#include "FakeClock.h"
+#include "Check.h"
+
+#define STEPS 3000000L
+// The main loop can fall behind by a few ticks; timers must still
+// expire on the first update after they're due
+#define MAX_STEP_MS 3U
+
+// Start 64 seconds before the millisecond counter wraps
+#define START_US ((((uint64_t) 1U << 32) - 65536U) * 1000U)
+
+static uint32_t due[TIMER_COUNT];
+static bool armed[TIMER_COUNT];
+
+static void TestRandomTimers()
+{
+	long fired = 0;
+	long early = 0;
+	long late = 0;
+	long unexpected = 0;
+
+	SetFakeMicroseconds(START_US);
+	InitTimers();
+	srand(1);
+
+	for (long step=0;step<STEPS;step++) {
+		uint32_t now = GetMillisecondCounter();
+		// Mostly start timers that aren't running, so that long timers
+		// usually get to expire
+		int start = rand() % TIMER_COUNT;
+		if (((rand() % 100) == 0) && (( ! armed[start]) || ((rand() % 10) == 0))) {
+			uint32_t duration = ((rand() % 4) == 0) ? (rand() % 1000000) : (rand() % 2000);
+			StartTimer((TimerName) start, duration);
+			due[start] = now + ((duration == 0U) ? 1U : duration);
+			armed[start] = true;
+		}
+		int stop = rand() % TIMER_COUNT;
+		if ((rand() % 10000) == 0) {
+			StopTimer((TimerName) stop);
+			armed[stop] = false;
+		}
+
+		AdvanceFakeMilliseconds(((rand() % 20) == 0) ? MAX_STEP_MS : 1U);
+		UpdateTimers();
+		now = GetMillisecondCounter();
+
+		for (int i=0;i<TIMER_COUNT;i++) {
+			int32_t lateness = (int32_t) (now - due[i]);
+			if (TimerHasExpired((TimerName) i)) {
+				fired++;
+				if ( ! armed[i]) {
+					unexpected++;
+				}
+				else if (lateness < 0) {
+					early++;
+				}
+				else if (lateness >= (int32_t) MAX_STEP_MS) {
+					late++;
+				}
+				armed[i] = false;
+			}
+			else if (armed[i] && (lateness >= (int32_t) MAX_STEP_MS)) {
+				late++;
+				armed[i] = false;
+			}
+		}
+	}
+
+	CHECK(fired > 1000);
+	CHECK_EQUAL(0, early);
+	CHECK_EQUAL(0, late);
+	CHECK_EQUAL(0, unexpected);
+}
+
+static void TestPeriodicTimer()
+{
+	SetFakeMicroseconds(((uint64_t) 0xFFFFFFF0U) * 1000U);
+	InitTimers();
+	StartPeriodicTimer(SwitchSampleTimer, 7U);
+
+	int expiries = 0;
+	for (int ms=1;ms<=70;ms++) {
+		AdvanceFakeMilliseconds(1U);
+		UpdateTimers();
+		if (TimerHasExpired(SwitchSampleTimer)) {
+			CHECK_EQUAL(0, ms % 7);
+			expiries++;
+		}
+		CHECK(IsTimerRunning(SwitchSampleTimer));
+		CHECK(GetTimeToNextTimer(100U) <= 7U);
+	}
+	CHECK_EQUAL(10, expiries);
+	CHECK_EQUAL(1U, GetRunningTimerCount());
+
+	StopTimer(SwitchSampleTimer);
+	CHECK( ! IsTimerRunning(SwitchSampleTimer));
+	CHECK_EQUAL(0U, GetRunningTimerCount());
+}
+
+int main()
+{
+	TestRandomTimers();
+	TestPeriodicTimer();
+	return CHECK_RESULT();
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: the transmit edge check used to blank ADC samples.  The real
+// transmitter interrupt handler sends frames on a simulated TIM2 (one
+// count per microsecond, the output high while the count is below
+// COMPARE).  Every edge inside a sampling window must be reported, and
+// nothing may be reported in the gap between frames where the output
+// is held low.
+
+#include <stdio.h>
+#include <stdint.h>
+#include <vector>
+
+#include "cmsis.h"
+#include "Transmitter.h"
+#include "Peripherals.h"
+#include "Check.h"
+
+extern "C" void TIM2_IRQHandler();
+
+#define FRAMES 20U
+#define WINDOW_US ((uint16_t) 55U)
+#define GUARD_US ((uint16_t) 20U)
+
+// Output changed in (from, to]
+static bool EdgeBetween(const std::vector<bool> &output, size_t from, size_t to)
+{
+	for (size_t t=from+1U;t<=to;t++) {
+		if (output[t] != output[t-1U]) {
+			return true;
+		}
+	}
+	return false;
+}
+
+int main()
+{
+	if (( ! MapGpioPorts()) || ( ! MapRegisters(TIM2_BASE, sizeof(TIM_TypeDef)))
+			|| ( ! MapRegisters(SCS_BASE, 0x1000U))) {
+		fprintf(stderr, "test_transmitedge.cpp: can't map the registers on this host\n");
+		return 1;
+	}
+
+	InitTransmitter();
+	StartTransmitting(true);
+	UpdateTransmitter();
+
+	std::vector<bool> output;
+	std::vector<bool> near;
+	std::vector<bool> gap;
+	while (GetTransmittedFrameCount() < FRAMES) {
+		output.push_back(TIM2->CNT < TIM2->CCR2);
+		near.push_back(IsNearTransmitEdge(WINDOW_US, GUARD_US));
+		gap.push_back(TIM2->CCR2 == 0U);
+
+		TIM2->CNT++;
+		if (TIM2->CNT > TIM2->ARR) {
+			TIM2->CNT = 0U;
+			TIM2_IRQHandler();
+		}
+	}
+
+	uint32_t missed = 0U;
+	uint32_t gap_blanked = 0U;
+	uint32_t blanked = 0U;
+	uint32_t gap_samples = 0U;
+	size_t samples = output.size() - (WINDOW_US + GUARD_US);
+	for (size_t t=GUARD_US;t<samples;t++) {
+		blanked += near[t] ? 1U : 0U;
+		if (EdgeBetween(output, t, t + WINDOW_US) && ( ! near[t])) {
+			missed++;
+		}
+		if (gap[t] && ( ! EdgeBetween(output, t - GUARD_US, t + WINDOW_US + GUARD_US))) {
+			gap_samples++;
+			gap_blanked += near[t] ? 1U : 0U;
+		}
+	}
+
+	fprintf(stderr, "window %u us guard %u us: blanked %.1f%% of %zu start times, "
+			"%u of %u in the gap between frames\n",
+			WINDOW_US, GUARD_US, (100.0 * blanked) / samples, samples - GUARD_US,
+			gap_blanked, gap_samples);
+	CHECK_EQUAL(0U, missed);
+	CHECK(gap_samples > (samples / 3U));
+	CHECK_EQUAL(0U, gap_blanked);
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,163 @@
+/*
+ * This file is part of the Cordless Power Tool Vacuum Start distribution
+ * (https://github.com/abudden/cordlessvacuumstart).
+ * Copyright (c) 2022 A. S. Budden
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, version 3.
+ *
+ * This program is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+// Test: three simulated eight hour workshop days (a 20 second cut every
+// three minutes, with the vacuum running on for three seconds) through
+// the usage counters and the persistent store.  The totals must be
+// right and must survive a restart.  The flash must only be written
+// about once per cut, so the log fills up and is compacted a few times,
+// but the spare sector must never be erased while the vacuum is on (an
+// erase stalls the main loop: see EraseFlashSector).
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "Usage.h"
+#include "Store.h"
+#include "Transmitter.h"
+#include "Analogue.h"
+#include "FakeClock.h"
+#include "FlashStub.h"
+#include "Check.h"
+
+#define DAYS 3U
+#define DAY_MS ((uint32_t) (8U * 3600U * 1000U))
+#define CYCLE_MS ((uint32_t) 180000U)
+#define TOOL_MS ((uint32_t) 20000U)
+#define RUN_ON_MS ((uint32_t) 3000U)
+#define TURN_OFF_MS ((uint32_t) 2000U)
+#define FRAME_MS ((uint32_t) 50U)
+#define TOOL_CURRENT ((uint16_t) 200U)
+#define CYCLES (DAYS * (DAY_MS / CYCLE_MS))
+
+static uint16_t current = 0U;
+static TransmitState transmit_state = TRANSMIT_Disabled;
+static uint32_t frames = 0U;
+
+uint16_t GetAnalogueCurrent()
+{
+	return current;
+}
+
+uint16_t GetLowCurrentThreshold()
+{
+	return 50U;
+}
+
+uint8_t GetTransmitterState()
+{
+	return (uint8_t) transmit_state;
+}
+
+uint32_t GetTransmittedFrameCount()
+{
+	return frames;
+}
+
+bool IsApplicationIdle()
+{
+	return (transmit_state != TRANSMIT_TurnOn);
+}
+
+bool IsPrintSupportIdle()
+{
+	return true;
+}
+
+static bool Near(uint32_t expected, uint32_t actual, uint32_t tolerance)
+{
+	uint32_t difference = (actual > expected) ? (actual - expected) : (expected - actual);
+	return (difference <= tolerance);
+}
+
+int main()
+{
+	uint32_t erases_while_on = 0U;
+
+	ClearStubFlash();
+	SetFakeMicroseconds(1000U);
+	InitStore();
+	InitUsage();
+
+	for (uint32_t ms=0U;ms<(DAYS * DAY_MS);ms++) {
+		uint32_t t = ms % CYCLE_MS;
+		current = (t < TOOL_MS) ? TOOL_CURRENT : 0U;
+		if (t < (TOOL_MS + RUN_ON_MS)) {
+			transmit_state = TRANSMIT_TurnOn;
+		}
+		else if (t < (TOOL_MS + RUN_ON_MS + TURN_OFF_MS)) {
+			transmit_state = TRANSMIT_TurnOff;
+		}
+		else {
+			transmit_state = TRANSMIT_Disabled;
+		}
+		if ((transmit_state != TRANSMIT_Disabled) && ((ms % FRAME_MS) == 0U)) {
+			frames++;
+		}
+
+		if ((ms % USAGE_SAMPLE_MS) == 0U) {
+			UpdateUsage();
+		}
+		uint32_t erases = GetStubFlashEraseCount();
+		UpdateStore();
+		if ((transmit_state == TRANSMIT_TurnOn) && (GetStubFlashEraseCount() != erases)) {
+			erases_while_on++;
+		}
+		AdvanceFakeMilliseconds(1U);
+	}
+
+	for (int i=0;i<USAGE_COUNT;i++) {
+		fprintf(stderr, "%-14s %u\n", GetUsageName((UsageCounter) i), GetUsage((UsageCounter) i));
+	}
+	const StoreStatistics *statistics = GetStoreStatistics();
+	fprintf(stderr, "records written %u compactions %u erases %u\n",
+			statistics->writes, statistics->compactions, GetStubFlashEraseCount());
+
+	CHECK_EQUAL(CYCLES, GetUsage(VacuumCyclesUsage));
+	CHECK_EQUAL(CYCLES, GetUsage(ToolRunsUsage));
+	// The part of a second since the last whole one is only kept in RAM
+	CHECK(Near((CYCLES * TOOL_MS) / 1000U, GetUsage(ToolOnSecondsUsage), 1U));
+	CHECK(Near((CYCLES * (TOOL_MS + RUN_ON_MS)) / 1000U, GetUsage(VacuumOnSecondsUsage), 1U));
+	CHECK_EQUAL(TOOL_CURRENT, GetUsage(PeakCurrentUsage));
+	CHECK_EQUAL(TOOL_CURRENT, GetAverageToolCurrent());
+	// Frames go to whatever is being sent when they're counted, so a
+	// frame or two can go to the wrong total when the state changes
+	CHECK(Near(CYCLES * ((TOOL_MS + RUN_ON_MS) / FRAME_MS), GetUsage(OnFramesUsage), 2U * CYCLES));
+	CHECK(Near(CYCLES * (TURN_OFF_MS / FRAME_MS), GetUsage(OffFramesUsage), 2U * CYCLES));
+
+	// At most one flush (of every counter) per cut
+	CHECK(statistics->writes <= (CYCLES * USAGE_COUNT));
+	CHECK(statistics->compactions > 0U);
+	CHECK(GetStubFlashEraseCount() <= (statistics->compactions + 1U));
+	CHECK_EQUAL(0U, erases_while_on);
+	CHECK(IsStoreIdle());
+
+	// Everything was flushed when the last cut finished
+	uint32_t totals[USAGE_COUNT];
+	for (int i=0;i<USAGE_COUNT;i++) {
+		totals[i] = GetUsage((UsageCounter) i);
+	}
+	InitStore();
+	InitUsage();
+	for (int i=0;i<USAGE_COUNT;i++) {
+		CHECK_EQUAL(totals[i], GetUsage((UsageCounter) i));
+	}
+
+	return CHECK_RESULT();
+}
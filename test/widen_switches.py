@@ -0,0 +1,107 @@
+#!/usr/bin/python3
+
+# This file is part of the Cordless Power Tool Vacuum Start distribution
+# (https://github.com/abudden/cordlessvacuumstart).
+# Copyright (c) 2022 A. S. Budden
+# 
+# This program is free software: you can redistribute it and/or modify  
+# it under the terms of the GNU General Public License as published by  
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but 
+# WITHOUT ANY WARRANTY; without even the implied warranty of 
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License 
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+# Make a copy of Switches.h and Switches.cpp with a table of numbered
+# switches (S0, S1, ...) in place of the push button, each with its own
+# debounce timer, so that the switch debouncing can be benchmarked with
+# more switches than the firmware has.  Switch n is on pin n % 16 of
+# GPIOA, GPIOB, ... and S0 is also called PushButtonSwitch.
+# SwitchDebounce.h and SwitchDebounce.cpp are copied unchanged so that
+# they include the widened Timers.h.
+
+import sys
+import os
+import re
+import argparse
+
+if sys.hexversion < 0x03050000:
+    raise Exception("This script requires Python 3.5+")
+
+PORTS = ['GPIOA', 'GPIOB', 'GPIOC']
+
+def Substitute(pattern, replacement, text, filename):
+    text, count = re.subn(pattern, replacement, text, flags=re.DOTALL)
+    if count != 1:
+        raise Exception("Table not found in %s" % filename)
+    return text
+
+def main():
+    parser = argparse.ArgumentParser(description="Widen the switch table")
+    parser.add_argument('switches', help="Directory containing Switches.h, Switches.cpp and SwitchDebounce.*")
+    parser.add_argument('timers', help="Directory containing Timers.h and Timers.cpp")
+    parser.add_argument('output', help="Directory for the widened copies")
+    parser.add_argument('--count', type=int, default=32, help="Number of switches")
+    args = parser.parse_args()
+
+    if not 1 <= args.count <= 16 * len(PORTS):
+        raise Exception("Switch count must be between 1 and %d" % (16 * len(PORTS)))
+
+    names = ['S%d' % i for i in range(args.count)]
+    timers = ['SwitchTimer%d' % i for i in range(args.count)]
+
+    with open(os.path.join(args.switches, 'Switches.h'), 'r') as fh:
+        header = fh.read()
+    enumeration = ''.join('\t%s,\n' % name for name in names)
+    enumeration += '\tLastSwitchIndex = %s,\n' % names[-1]
+    enumeration += '\tPushButtonSwitch = %s\n' % names[0]
+    header = Substitute(r'(typedef enum _Switches\n\{\n).*?(\} SwitchName;)',
+            lambda m: m.group(1) + enumeration + m.group(2),
+            header, 'Switches.h')
+
+    with open(os.path.join(args.switches, 'Switches.cpp'), 'r') as fh:
+        source = fh.read()
+    match = re.search(r'\} SwitchList\[SWITCH_COUNT\] = \{\n(\t\{PushButtonSwitch,.*?\},\n)\};', source)
+    if match is None:
+        raise Exception("Push button row not found in Switches.cpp")
+    row = match.group(1)
+    table = ''
+    for i, name in enumerate(names):
+        table += (row.replace('PushButtonSwitch', name)
+                .replace('PUSH_BUTTON_PIN', '%s, %d' % (PORTS[i // 16], i % 16))
+                .replace('PushButtonDebounceTimer', timers[i])
+                .replace('"Push Button"', '"%s"' % name))
+    source = source[:match.start(1)] + table + source[match.end(1):]
+
+    with open(os.path.join(args.timers, 'Timers.h'), 'r') as fh:
+        timer_header = fh.read()
+    enumeration = ''.join('\t%s,\n' % name for name in timers)
+    enumeration += '\tLastTimerIndex = %s\n' % timers[-1]
+    timer_header = Substitute(r'(\n)\tLastTimerIndex = \w+\n(\} TimerName;)',
+            lambda m: m.group(1) + enumeration + m.group(2),
+            timer_header, 'Timers.h')
+
+    with open(os.path.join(args.timers, 'Timers.cpp'), 'r') as fh:
+        timer_source = fh.read()
+    table = ''.join('\t{%s, NULL, "%s"},\n' % (name, name) for name in timers)
+    timer_source = Substitute(r'(\} TimerList\[TIMER_COUNT\] = \{\n.*?\n)(\};)',
+            lambda m: m.group(1) + table + m.group(2),
+            timer_source, 'Timers.cpp')
+
+    copies = []
+    for filename in ['SwitchDebounce.h', 'SwitchDebounce.cpp']:
+        with open(os.path.join(args.switches, filename), 'r') as fh:
+            copies.append((filename, fh.read()))
+
+    os.makedirs(args.output, exist_ok=True)
+    for filename, text in copies + [('Switches.h', header), ('Switches.cpp', source),
+            ('Timers.h', timer_header), ('Timers.cpp', timer_source)]:
+        with open(os.path.join(args.output, filename), 'w') as fh:
+            fh.write(text)
+
+if __name__ == "__main__":
+    main()
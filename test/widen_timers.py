@@ -0,0 +1,69 @@
+#!/usr/bin/python3
+
+# This file is part of the Cordless Power Tool Vacuum Start distribution
+# (https://github.com/abudden/cordlessvacuumstart).
+# Copyright (c) 2022 A. S. Budden
+# 
+# This program is free software: you can redistribute it and/or modify  
+# it under the terms of the GNU General Public License as published by  
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but 
+# WITHOUT ANY WARRANTY; without even the implied warranty of 
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License 
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+# Make a copy of Timers.h and Timers.cpp with a table of numbered timers
+# (T0, T1, ...) in place of the real ones, so that the timer wheel can be
+# benchmarked with more timers running than the firmware has
+
+import sys
+import os
+import re
+import argparse
+
+if sys.hexversion < 0x03050000:
+    raise Exception("This script requires Python 3.5+")
+
+def main():
+    parser = argparse.ArgumentParser(description="Widen the timer table")
+    parser.add_argument('source', help="Directory containing Timers.h and Timers.cpp")
+    parser.add_argument('output', help="Directory for the widened copies")
+    parser.add_argument('--count', type=int, default=100, help="Number of timers")
+    args = parser.parse_args()
+
+    if not 1 <= args.count < 255:
+        raise Exception("Timer count must be between 1 and 254")
+
+    names = ['T%d' % i for i in range(args.count)]
+
+    with open(os.path.join(args.source, 'Timers.h'), 'r') as fh:
+        header = fh.read()
+    enumeration = ''.join('\t%s,\n' % name for name in names)
+    enumeration += '\tLastTimerIndex = %s\n' % names[-1]
+    header, count = re.subn(r'(typedef enum _Timers\n\{\n).*?(\} TimerName;)',
+            lambda m: m.group(1) + enumeration + m.group(2),
+            header, flags=re.DOTALL)
+    if count != 1:
+        raise Exception("Timer enumeration not found in Timers.h")
+
+    with open(os.path.join(args.source, 'Timers.cpp'), 'r') as fh:
+        source = fh.read()
+    table = ''.join('\t{%s, NULL, "%s"},\n' % (name, name) for name in names)
+    source, count = re.subn(r'(\} TimerList\[TIMER_COUNT\] = \{\n).*?(\};)',
+            lambda m: m.group(1) + table + m.group(2),
+            source, flags=re.DOTALL)
+    if count != 1:
+        raise Exception("Timer list not found in Timers.cpp")
+
+    os.makedirs(args.output, exist_ok=True)
+    with open(os.path.join(args.output, 'Timers.h'), 'w') as fh:
+        fh.write(header)
+    with open(os.path.join(args.output, 'Timers.cpp'), 'w') as fh:
+        fh.write(source)
+
+if __name__ == "__main__":
+    main()
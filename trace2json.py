@@ -0,0 +1,170 @@
+#!/usr/bin/python3
+
+# This file is part of the Cordless Power Tool Vacuum Start distribution
+# (https://github.com/abudden/cordlessvacuumstart).
+# Copyright (c) 2022 A. S. Budden
+# 
+# This program is free software: you can redistribute it and/or modify  
+# it under the terms of the GNU General Public License as published by  
+# the Free Software Foundation, version 3.
+#
+# This program is distributed in the hope that it will be useful, but 
+# WITHOUT ANY WARRANTY; without even the implied warranty of 
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU 
+# General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License 
+# along with this program. If not, see <http://www.gnu.org/licenses/>.
+
+# Convert a trace dump (the output of the "trace" command in a build
+# compiled with -D TRACING, captured from the serial terminal) into a
+# Chrome trace / Perfetto JSON file.  Open the result in
+# https://ui.perfetto.dev or chrome://tracing
+
+import sys
+import re
+import json
+import argparse
+
+if sys.hexversion < 0x03050000:
+    raise Exception("This script requires Python 3.5+")
+
+# Must match TraceEventId in Trace.h
+EVENTS = {
+        1: 'ApplicationState',
+        2: 'TransmitWord',
+        3: 'FrameStart',
+        4: 'FrameEnd',
+        5: 'TransmitterIsrEntry',
+        6: 'TransmitterIsrExit',
+        7: 'ButtonRawEdge',
+        8: 'ButtonEdge',
+        9: 'AdcWindow',
+        }
+
+ARG_BITS = 26
+ARG_MASK = (1 << ARG_BITS) - 1
+
+# Must match the ControllerState enumeration in HysteresisController.h
+APPLICATION_STATES = ['Idle', 'TurningOn', 'Delay', 'TurningOff', 'PredictedOn']
+
+# Track (thread) IDs used to lay out the timeline
+TRACKS = {
+        'Application': 1,
+        'Transmitter': 2,
+        'TIM2 ISR': 3,
+        'Button': 4,
+        'ADC': 5,
+        }
+
+begin_matcher = re.compile(r'TRACE BEGIN (?P<mhz>\d+) (?P<count>\d+)')
+record_matcher = re.compile(r'^(?P<timestamp>[0-9A-Fa-f]{8}) (?P<event>[0-9A-Fa-f]{8})$')
+
+
+def read_records(fh):
+    """Return the clock speed and the list of (timestamp, id, arg) from
+    the last complete dump in the file."""
+    dumps = []
+    current = None
+    mhz = None
+    for line in fh:
+        line = line.strip()
+        m = begin_matcher.search(line)
+        if m is not None:
+            mhz = int(m.group('mhz'))
+            current = []
+            continue
+        if current is None:
+            continue
+        if line.endswith('TRACE END'):
+            dumps.append((mhz, current))
+            current = None
+            continue
+        m = record_matcher.match(line)
+        if m is not None:
+            event = int(m.group('event'), 16)
+            current.append((int(m.group('timestamp'), 16), event >> ARG_BITS, event & ARG_MASK))
+    if len(dumps) == 0:
+        raise Exception("No complete trace dump found")
+    return dumps[-1]
+
+
+def unwrap(records):
+    """The cycle counter is 32 bits and wraps every minute or so at
+    72 MHz: make the timestamps monotonic (records are in order)."""
+    offset = 0
+    previous = None
+    result = []
+    for timestamp, event_id, arg in records:
+        if previous is not None and timestamp + offset < previous - (1 << 31):
+            offset += (1 << 32)
+        previous = timestamp + offset
+        result.append((timestamp + offset, event_id, arg))
+    return result
+
+
+def convert(mhz, records):
+    trace_events = []
+    for name, tid in TRACKS.items():
+        trace_events.append({'name': 'thread_name', 'ph': 'M', 'pid': 1, 'tid': tid,
+            'args': {'name': name}})
+
+    if len(records) == 0:
+        return trace_events
+
+    start = records[0][0]
+    application_state = None
+    for timestamp, event_id, arg in records:
+        ts = (timestamp - start) / mhz # microseconds
+        name = EVENTS.get(event_id, 'Unknown%d' % event_id)
+        if name == 'ApplicationState':
+            # Show each state as a slice on the application track
+            if application_state is not None:
+                trace_events.append({'name': application_state, 'ph': 'E', 'ts': ts, 'pid': 1, 'tid': TRACKS['Application']})
+            if arg < len(APPLICATION_STATES):
+                application_state = APPLICATION_STATES[arg]
+            else:
+                application_state = 'State%d' % arg
+            trace_events.append({'name': application_state, 'ph': 'B', 'ts': ts, 'pid': 1, 'tid': TRACKS['Application']})
+        elif name == 'FrameStart':
+            trace_events.append({'name': 'Frame', 'ph': 'B', 'ts': ts, 'pid': 1, 'tid': TRACKS['Transmitter'],
+                'args': {'word': '0x%07X' % arg}})
+        elif name == 'FrameEnd':
+            trace_events.append({'name': 'Frame', 'ph': 'E', 'ts': ts, 'pid': 1, 'tid': TRACKS['Transmitter']})
+        elif name == 'TransmitWord':
+            trace_events.append({'name': 'TransmitWord', 'ph': 'i', 's': 't', 'ts': ts, 'pid': 1, 'tid': TRACKS['Transmitter'],
+                'args': {'word': '0x%07X' % arg}})
+        elif name == 'TransmitterIsrEntry':
+            trace_events.append({'name': 'TIM2_IRQHandler', 'ph': 'B', 'ts': ts, 'pid': 1, 'tid': TRACKS['TIM2 ISR']})
+        elif name == 'TransmitterIsrExit':
+            trace_events.append({'name': 'TIM2_IRQHandler', 'ph': 'E', 'ts': ts, 'pid': 1, 'tid': TRACKS['TIM2 ISR']})
+        elif name in ('ButtonRawEdge', 'ButtonEdge'):
+            trace_events.append({'name': name, 'ph': 'i', 's': 't', 'ts': ts, 'pid': 1, 'tid': TRACKS['Button'],
+                'args': {'pin': arg >> 1, 'level': arg & 1}})
+        elif name == 'AdcWindow':
+            trace_events.append({'name': 'AdcWindow', 'ph': 'i', 's': 't', 'ts': ts, 'pid': 1, 'tid': TRACKS['ADC'],
+                'args': {'average': arg}})
+            trace_events.append({'name': 'ADC average', 'ph': 'C', 'ts': ts, 'pid': 1,
+                'args': {'average': arg}})
+        else:
+            trace_events.append({'name': name, 'ph': 'i', 's': 'g', 'ts': ts, 'pid': 1, 'tid': 0,
+                'args': {'arg': arg}})
+    return trace_events
+
+
+parser = argparse.ArgumentParser(description="Convert a Cordless Vacuum Starter trace dump to Chrome trace JSON")
+parser.add_argument('input',
+        help='Captured serial output containing a trace dump')
+parser.add_argument('output',
+        help='JSON file to write')
+args = parser.parse_args()
+
+with open(args.input, 'r', encoding='utf8', errors='replace') as fh:
+    mhz, records = read_records(fh)
+
+trace_events = convert(mhz, unwrap(records))
+
+with open(args.output, 'w', encoding='utf8') as fh:
+    json.dump({'traceEvents': trace_events, 'displayTimeUnit': 'ns'}, fh, indent=1)
+
+print("Converted %d records" % len(records))